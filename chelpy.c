@@ -29,186 +29,103 @@
 
 #include <Python.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "u64_chess.h"
 
 // This is needed for polyglot key generation
 #include "u64_polyglot.h"
 
-char lib_buffer[102400];
-char lib_mv[4<<8];
-int depth;
+// PGN parsing and PGN files reading
+#include "u64_pgn.h"
 
-// freaking iterations
-char lib_ii_mv[(4<<8)*32];
-U8 *lib_ii_po[32];
+// Position database
+#include "u64_posdb.h"
 
-Py_ssize_t isquares[64];
+// Endgame tables probing
+#include "u64_egtb.h"
 
-const int matdifvals[] = { 900, 500, 320, 318, 110, 20000, 0,0, -900, -500, -320, -318, -110, -20000, 0,0 };
+// Mate solver, playouts
+#include "u64_search.h"
 
-//------------------------------------------
-//
-//	Parse PGN part
-//
-void parse_pgn_moves( char *pgn ) {
-
-    char *s=pgn; 
-    char *u=lib_buffer;
-	
-    int q=0;
-    int mn=1;
-
-    U8 mv[4<<8];
-    char Pc=0, Pp=0;
-    int w, i, N, fcastle=0, prom=0, found=0;
-    char *P;
-    char c, h1=0,v1=0,h2=0,v2=0;
-    U8 ty=0, fl=0, sq1=0, sq2=0;
-    U8 *po;
-
-    for(;*s!=0;s++) {
-        c = *s;
-        if(c=='{') q++;
-        if(q>0) *s=' ';       // remove comments
-        if(c=='}') q--;
-        if(c<=13) *s=' ';   // remove TABs etc...
-        if(*s=='e' && *(s+1)=='p') { *s=' '; *(s+1)=' '; }      // ep case
-        if(c=='*') *s=' ';
-    }
-    s=pgn;
-	*u = 0;
-
-    MoveGen(mv);
-
-    for(;*s!=0;s++) {
-        while(*s==' ') s++;
-        if(*s==0) break;
-
-        // skip number
-        c = *s;
-        if (c >= '1' && c <= '9') {
-            while (*s != 0 && *s != '.' && *s != ' ') s++;
-        }
-        while (*s == '.' || *s == ' ') s++;
-        if (*s == 0) break;
+// MCTS with batched leaf evaluation
+#include "u64_mcts.h"
 
-        fcastle = 0;
-        if((strncmp(s,"0-0-0",5)==0)||(strncmp(s,"O-O-O",5)==0)) {
-            fcastle = 2;
-        }
-        else {
-            if((strncmp(s,"0-0",3)==0)||(strncmp(s,"O-O",3)==0)) {
-                fcastle = 1;
-            }
-        }
+char lib_buffer[102400];
+char lib_mv[4<<8];
+int depth;
 
-        // obtain chess move from pgn string
-
-        if(!fcastle) {
-            Pc = 0; w = 0; Pp = 0;
-            h1 = 0; v1 = 0; h2 = 0; v2 = 0;
-            while(*s!=' ' && *s!=0) {
-                c = *s;
-                if(c=='.') w=0;
-                if(Pc==0) {
-                    P = strchr("QRBNPK",c);
-                    if(P!=NULL) { Pc = *P; w=1; }
-                }
-                if(w<3 && (c=='x'||c=='-'||c==':')) w=3;
+// freaking iterations
+#define LIB_II_DEPTH 32
+char lib_ii_mv[(4<<8)*LIB_II_DEPTH];
+U8 *lib_ii_po[LIB_II_DEPTH];
 
-                if(c>='a' && c<='h') {
-                    if(w<3 && h1==0) { h1=c; w=2; }
-                    else if(w<6) { h2=c; w=4; }
-                }
-                if(w>0 && c>='1' && c<='8') {
-                    if(w<3 && v1==0) { v1=c; w=3; }
-                    else if(w<6) { v2=c; w=5; }
-                }
-                if(c=='=') { w=6; c = *(++s); }
-                if(w>4) {
-                    P = strchr("QRBN",c);
-                    if(P!=NULL) Pp = (*P)+32;
-                    else {
-                        P = strchr("qrbn",c);
-                        if(P!=NULL) Pp = *P;
-                    }
-                }
+Py_ssize_t isquares[64];
 
-                s++;
-            }
-            if(h2==0) { h2=h1; v2=v1; h1=0; v1=0; }
-            if(h2==0 && v2==0) continue;
-        }
+// open PGN files
+#define LIB_PGN_MAX 8
+PgnReader *lib_pgn[LIB_PGN_MAX];
 
-        po = mv;
-        N = *(po++);
-        found = 0;
+// Long calls own the board while the GIL is released or Python callbacks
+// run, other threads get RuntimeError from board calls until they end.
+int lib_busy = 0;
+unsigned long lib_busy_thread;
 
-        // find this move in the movegen list
+U8 lib_board_free() {
+	if(lib_busy && lib_busy_thread!=PyThread_get_thread_ident()) {
+		PyErr_SetString( PyExc_RuntimeError, "chelpy board is in use by a call of another thread" );
+		return 0;
+	}
+	return 1;
+}
 
-        for(i=0; i<N; i++) {
+#define LIB_BOARD if(!lib_board_free()) return NULL;
 
-            ty = (*po) & 7;
-            sq1 = *(po+1);
-            sq2 = *(po+2);
-            fl = *(po+3);
+// Callbacks of walk and mcts_search see the board at the node, calls
+// that set or move it get RuntimeError until the callback returns.
+int lib_callback = 0;
 
-            if(fl&32) {
-              if (sq1>sq2 && fcastle==2) found = 1;
-              if (sq1<sq2 && fcastle==1) found = 1;
-            }
+U8 lib_board_set() {
+	if(!lib_board_free()) return 0;
+	if(lib_callback) {
+		PyErr_SetString( PyExc_RuntimeError, "chelpy board can not be changed in a walk or mcts_search callback" );
+		return 0;
+	}
+	return 1;
+}
 
-            if(!found && ((ty==4 && Pc==0)||(pieces[ty]==Pc))) {
-                found = 1;
-                if(h1!=0 && h1!=((sq1&7)+'a')) found=0;
-                if(v1!=0 && v1!=((sq1>>3)+'1')) found=0;
-                if(h2!=0 && h2!=((sq2&7)+'a')) found=0;
-                if(v2!=0 && v2!=((sq2>>3)+'1')) found=0;
-
-                prom = 0;
-                if(fl&2) {   // promotion
-                    prom = pieces[ 8+((fl>>2)&3)];
-                    if(Pp!=0 && Pp != prom) found=0;
-                    }
-                }
-            if(found) {
-                    DoMove(po);
-                    *(u++) = ((sq1&7)+'a');
-                    *(u++) = ((sq1>>3)+'1');
-                    *(u++) = ((sq2&7)+'a');
-                    *(u++) = ((sq2>>3)+'1');
-                    if(prom) *(u++) = prom;
-                    *(u++) = ' ';
-                    *u=0;
-                    MoveGen(mv);
-                    if(!ToMove) mn++;
-                    break;
-                    }
-            po += 4;
-        }
+#define LIB_BOARD_SET if(!lib_board_set()) return NULL;
 
-    }
+// after LIB_BOARD, before work on board
+void lib_enter() {
+	lib_busy++;
+	lib_busy_thread = PyThread_get_thread_ident();
 }
 
+void lib_leave() {
+	lib_busy--;
+}
 
-
+const int matdifvals[] = { 900, 500, 320, 318, 110, 20000, 0,0, -900, -500, -320, -318, -110, -20000, 0,0 };
 
 //------------------------------------------
 //
 //	python interface
 
 PyObject *setstartpos ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	SetStartPos();
 	return Py_BuildValue( "", NULL );
 }
 
 PyObject *sboard ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	sBoard( lib_buffer );
 	return Py_BuildValue( "s", lib_buffer );
 }
 
 PyObject *sboard64 ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	U8 c,j,sq;
 	char *s = lib_buffer;
 	for(j=0;j<64;j++) s[j]=' ';
@@ -228,6 +145,7 @@ PyObject *sboard64 ( PyObject *self, PyObject *args ) {
 // An unique position string 70 bytes long to save position somewhere
 // (kinda key code for convinience)
 PyObject *uniq ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	U8 c,j,sq;
 	char *s = lib_buffer;
 	for(j=0;j<64;j++) s[j]=' ';
@@ -259,6 +177,7 @@ PyObject *uniq ( PyObject *self, PyObject *args ) {
 
 // faster position setup from uniq code
 PyObject *setasuniq ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	char *ustr;
 	PyArg_ParseTuple( args,  "s",  &ustr);
 	
@@ -299,18 +218,85 @@ PyObject *setasuniq ( PyObject *self, PyObject *args ) {
 		ENPSQ = 0LL;
 		}
 	
+	HalfMoves = 0; FullMoves = 1;
 	undo_p = undobuffer;
     mg_po = mg_cnt = mg_uci_list;
 	
 	return Py_BuildValue( "", NULL );
 }
 
+// compact binary position, POS_BYTES long
+PyObject *posbin ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	U8 b[POS_BYTES];
+	PosEncode( b );
+	return PyBytes_FromStringAndSize( (char *)b, POS_BYTES );
+}
+
+PyObject *setposbin ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	Py_buffer b;
+	if(!PyArg_ParseTuple( args,  "y*", &b )) return NULL;
+	U8 ok = (b.len>=POS_BYTES ? PosDecode( (U8 *)b.buf ) : 0);
+	PyBuffer_Release( &b );
+	if(!ok) { PyErr_SetString( PyExc_ValueError, "not a position" ); return NULL; }
+	Py_RETURN_NONE;
+}
+
+// positions of current board and after each uci move, bytes of POS_BYTES each
+PyObject *posbins ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	char *ucisstr, *s, uci[8];
+	int i, n = 1;
+	if(!PyArg_ParseTuple( args,  "s", &ucisstr )) return NULL;
+	for(s=ucisstr; *s; s++) if(*s>32 && (s==ucisstr || s[-1]<=32)) n++;
+	PyObject *r = PyBytes_FromStringAndSize( NULL, (Py_ssize_t)n*POS_BYTES );
+	U8 *b = (U8 *)PyBytes_AS_STRING(r);
+	PosEncode( b );
+	n = 1;
+	s = ucisstr;
+	while( (*s)>13 ) {
+		while((*s)==32) s++;
+		for( i=0; ((*s)>13) && (i<4); i++) uci[i]=(*(s++));
+		if( ((*s)>13) && (*s)!=32 ) uci[i++]=(*(s++));
+		uci[i]=0;
+		if(i<4 || !uciMove( uci )) break;
+		PosEncode( b+(n++)*POS_BYTES );
+	}
+	_PyBytes_Resize( &r, (Py_ssize_t)n*POS_BYTES );
+	return r;
+}
+
+// FENs of positions in bytes of POS_BYTES each, None if not a position
+PyObject *posbin_fens ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	Py_buffer b;
+	Py_ssize_t i, n;
+	if(!PyArg_ParseTuple( args,  "y*", &b )) return NULL;
+	n = b.len/POS_BYTES;
+	PyObject *list = PyList_New(n);
+	for(i=0; i<n; i++) {
+		if(PosDecode( (U8 *)b.buf + i*POS_BYTES )) {
+			sGetFEN( lib_buffer );
+			PyList_SET_ITEM( list, i, PyUnicode_FromString( lib_buffer ) );
+		}
+		else {
+			Py_INCREF(Py_None);
+			PyList_SET_ITEM( list, i, Py_None );
+		}
+	}
+	PyBuffer_Release( &b );
+	return list;
+}
+
 PyObject *getfen ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	sGetFEN( lib_buffer );
 	return Py_BuildValue( "s", lib_buffer );
 }
 
 PyObject *setfen ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	char *fenstr;
 	PyArg_ParseTuple( args,  "s",  &fenstr);
 	SetByFEN( fenstr );
@@ -318,23 +304,27 @@ PyObject *setfen ( PyObject *self, PyObject *args ) {
 }
 
 PyObject *movegen ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	MoveGen(lib_mv);
 	int count = lib_mv[0];
 	return Py_BuildValue( "i", count );
 }
 
 PyObject *legalmoves ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	sLegalMoves( lib_buffer, lib_mv );
 	return Py_BuildValue( "s", lib_buffer );
 }
 
 PyObject *ucimove ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	char *ucistr;
 	PyArg_ParseTuple( args,  "s", &ucistr );
 	return Py_BuildValue( "i", uciMove( ucistr ) );
 }
 
 PyObject *parseucimoves ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	char *ucisstr;
 	PyArg_ParseTuple( args,  "s", &ucisstr );
 	char *s = ucisstr;
@@ -351,17 +341,66 @@ PyObject *parseucimoves ( PyObject *self, PyObject *args ) {
 }
 
 
+// static exchange evaluation of uci move on current board
+PyObject *see ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	char *ucistr;
+	U8 mv[4];
+	PyArg_ParseTuple( args,  "s", &ucistr );
+	if( !uciToMv( ucistr, mv ) || !IsPseudoLegal( mv ) ) return Py_BuildValue( "i", 0 );
+	return Py_BuildValue( "i", SEE( mv ) );
+}
+
+// legal moves with SEE scores, tuple of (uci, see)
+PyObject *seemoves ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int scores[256];
+	char uci[8];
+	U8 *p = (U8 *)lib_mv;
+	MoveGen(p);
+	int i, n = *(p++);
+	SeeList( (U8 *)lib_mv, scores );
+
+	PyObject *tuple = PyTuple_New(n);
+	for(i=0; i<n; i++, p+=4) {
+		uci[0] = ((p[1]&7)+'a'); uci[1] = ((p[1]>>3)+'1');
+		uci[2] = ((p[2]&7)+'a'); uci[3] = ((p[2]>>3)+'1');
+		uci[4] = ((p[3]&2) ? pieces[8+((p[3]>>2)&3)] : 0);
+		uci[5] = 0;
+		PyTuple_SET_ITEM(tuple, i, Py_BuildValue( "(si)", uci, scores[i] ) );
+	}
+	return tuple;
+}
+
+// cache of MoveGen lists, size in MB, 0-off
+PyObject *movecache ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	double mb = 64;
+	if(!PyArg_ParseTuple( args, "|d", &mb )) return NULL;
+	long long n = MoveGenCache( (long long)(mb*1048576) );
+	if(n==0 && mb>0) return PyErr_NoMemory();
+	return Py_BuildValue( "L", n );
+}
+
+// (hits, misses) of cache since movecache
+PyObject *movecache_stats ( PyObject *self, PyObject *args ) {
+	return Py_BuildValue( "(LL)", mgc_hits, mgc_misses );
+}
+
 PyObject *undomove ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	UnDoMove();
 	return Py_BuildValue( "", NULL );
 }
 
 PyObject *swaptomove ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	ToMove^=1;
 	return Py_BuildValue( "i", ToMove );
 }
 
 PyObject *sidetomove ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	return Py_BuildValue( "i", ToMove );
 }
 
@@ -421,34 +460,928 @@ U8 seemslegit () {
 
 
 PyObject *seemslegitpos ( PyObject *self, PyObject *args ) {
-	return ( seemslegit() ? Py_True : Py_False );
+	LIB_BOARD
+	if(seemslegit()) Py_RETURN_TRUE;
+	Py_RETURN_FALSE;
 }
 
 PyObject *parsepgn ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
 	char *pgnstr;
 	PyArg_ParseTuple( args,  "s", &pgnstr );
-	parse_pgn_moves( pgnstr );
+	parse_pgn_moves( pgnstr, lib_buffer, sizeof(lib_buffer) );
 	return Py_BuildValue( "s", lib_buffer );
 }
 
+// tokens of movetext into list of (depth, kind, text, uci or None)
+CONST char *lib_pgn_kinds[] = { "", "move", "number", "comment", "nag", "(", ")", "result" };
+
+void lib_pgn_token( void *arg, PgnTok *t, int depth, char *uci ) {
+	PyObject *txt = PyUnicode_DecodeUTF8( t->s, t->len, "replace" );
+	PyObject *o = Py_BuildValue( "(isNz)", depth, lib_pgn_kinds[t->kind], txt, uci );
+	PyList_Append( (PyObject *)arg, o );
+	Py_DECREF(o);
+}
+
+PyObject *pgntokens ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	char *pgnstr;
+	if(!PyArg_ParseTuple( args,  "s", &pgnstr )) return NULL;
+	PyObject *list = PyList_New(0);
+	PgnWalk( pgnstr, lib_buffer, sizeof(lib_buffer), NULL, NULL, lib_pgn_token, list );
+	return list;
+}
+
+// [%eval] centipawns (mate n as +-(100000-n)) and [%clk] seconds of plies,
+// into e, c lists, None if not annotated
+void lib_pgn_annots( int n, int *evals, int *clks, PyObject **pe, PyObject **pc ) {
+	PyObject *e = PyList_New(n), *c = PyList_New(n);
+	for(int i=0; i<n; i++) {
+		if(evals[i]==PGN_NOVAL) { Py_INCREF(Py_None); PyList_SET_ITEM( e, i, Py_None ); }
+		else PyList_SET_ITEM( e, i, PyLong_FromLong( evals[i] ) );
+		if(clks[i]==PGN_NOVAL) { Py_INCREF(Py_None); PyList_SET_ITEM( c, i, Py_None ); }
+		else PyList_SET_ITEM( c, i, PyFloat_FromDouble( clks[i]/1000.0 ) );
+	}
+	*pe = e;
+	*pc = c;
+}
+
+int lib_evals[PGN_PLIES], lib_clks[PGN_PLIES];
+
+PyObject *parsepgnannots ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	char *pgnstr;
+	if(!PyArg_ParseTuple( args,  "s", &pgnstr )) return NULL;
+	int n = PgnWalk( pgnstr, lib_buffer, sizeof(lib_buffer), lib_evals, lib_clks, NULL, NULL );
+	PyObject *e, *c;
+	lib_pgn_annots( n, lib_evals, lib_clks, &e, &c );
+	return Py_BuildValue( "(sNN)", lib_buffer, e, c );
+}
+
+// PGN file reading, games one by one
+
+// tags of game into dictionary
+PyObject *pgnTags( PgnReader *r ) {
+	PyObject *tags = PyDict_New();
+	for(int i=0; i<r->ntags; i++) {
+		PyObject *v = PyUnicode_DecodeUTF8( r->val[i], strlen(r->val[i]), "replace" );
+		PyDict_SetItemString( tags, r->tag[i], v );
+		Py_DECREF(v);
+	}
+	return tags;
+}
+
+PyObject *pgn_open ( PyObject *self, PyObject *args ) {
+	char *path;
+	int h;
+	PyArg_ParseTuple( args,  "s", &path );
+	for(h=0; h<LIB_PGN_MAX && lib_pgn[h]!=NULL; h++);
+	if(h==LIB_PGN_MAX) return Py_BuildValue( "i", -1 );
+
+	PgnReader *r = (PgnReader *)malloc( sizeof(PgnReader) );
+	if(r==NULL) return Py_BuildValue( "i", -1 );
+	if(!PgnOpen( r, path )) {
+		free(r);
+		return Py_BuildValue( "i", -1 );
+	}
+	lib_pgn[h] = r;
+	return Py_BuildValue( "i", h );
+}
+
+// next game as (tags, ucis) or None, board is at the end of game,
+// flags 1: tokens added, 2: evals, clks added
+PyObject *pgn_next ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	int h, flags = 0;
+	PyObject *list = NULL, *e, *c;
+	PyArg_ParseTuple( args,  "i|i", &h, &flags );
+	if(h<0 || h>=LIB_PGN_MAX || lib_pgn[h]==NULL) Py_RETURN_NONE;
+
+	PgnReader *r = lib_pgn[h];
+	if(!PgnNextGame( r )) Py_RETURN_NONE;
+	if(flags&1) {
+		list = PyList_New(0);
+		r->visit = lib_pgn_token;
+		r->varg = list;
+	}
+	PgnPlayGame( r );
+	r->visit = NULL;
+	r->varg = NULL;
+
+	if(flags&2) lib_pgn_annots( r->nmoves, r->eval, r->clk, &e, &c );
+	switch(flags&3) {
+		case 1: return Py_BuildValue( "(NsN)", pgnTags( r ), r->ucis, list );
+		case 2: return Py_BuildValue( "(NsNN)", pgnTags( r ), r->ucis, e, c );
+		case 3: return Py_BuildValue( "(NsNNN)", pgnTags( r ), r->ucis, list, e, c );
+	}
+	return Py_BuildValue( "(Ns)", pgnTags( r ), r->ucis );
+}
+
+// where games of pgn_parallel go
+typedef struct {
+	PyObject *list;		// list of uci strings
+	PyObject *call;		// or callback(tags, ucis)
+	FILE *fo;			// or file, uci moves of game per line
+	int err;
+} lib_pgn_sink_t;
+
+void lib_pgn_sink( void *arg, PgnReader *r ) {
+	lib_pgn_sink_t *k = (lib_pgn_sink_t *)arg;
+	if(k->fo!=NULL) {
+		fputs( r->ucis, k->fo );
+		fputc( 10, k->fo );
+		return;
+	}
+	PyGILState_STATE g = PyGILState_Ensure();
+	if(!k->err) {
+		if(k->call!=NULL) {
+			PyObject *res = PyObject_CallFunction( k->call, "(Ns)", pgnTags( r ), r->ucis );
+			if(res==NULL) k->err = 1;
+			else Py_DECREF(res);
+		}
+		else {
+			PyObject *u = PyUnicode_FromString( r->ucis );
+			PyList_Append( k->list, u );
+			Py_DECREF(u);
+		}
+	}
+	PyGILState_Release(g);
+}
+
+// parse large PGN file in parallel, results in order of games
+PyObject *pgn_parallel ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	char *path;
+	int workers = 0;
+	PyObject *sink = NULL;
+	long long n;
+	lib_pgn_sink_t k = { NULL, NULL, NULL, 0 };
+
+	if(!PyArg_ParseTuple( args,  "s|iO", &path, &workers, &sink )) return NULL;
+
+#ifdef _WIN32
+	PyErr_SetString( PyExc_NotImplementedError, "pgn_parallel needs fork()" );
+	return NULL;
+#else
+	if(sink==NULL || sink==Py_None) k.list = PyList_New(0);
+	else if(PyUnicode_Check(sink)) {
+		k.fo = fopen( PyUnicode_AsUTF8(sink), "wb" );
+		if(k.fo==NULL) return PyErr_SetFromErrnoWithFilenameObject( PyExc_OSError, sink );
+	}
+	else if(PyCallable_Check(sink)) k.call = sink;
+	else {
+		PyErr_SetString( PyExc_TypeError, "sink should be None, file name or callable" );
+		return NULL;
+	}
+
+	lib_enter();
+	errno = 0;
+	Py_BEGIN_ALLOW_THREADS
+	n = PgnParallel( path, workers, lib_pgn_sink, &k );
+	Py_END_ALLOW_THREADS
+	lib_leave();
+
+	if(k.fo!=NULL) fclose(k.fo);
+	if(k.err) {
+		Py_XDECREF(k.list);
+		return NULL;
+	}
+	if(n<0) {
+		Py_XDECREF(k.list);
+		if(errno==0) {
+			PyErr_SetString( PyExc_RuntimeError, "pgn_parallel worker failed" );
+			return NULL;
+		}
+		return PyErr_SetFromErrnoWithFilename( PyExc_OSError, path );
+	}
+	if(k.list!=NULL) return k.list;
+	return Py_BuildValue( "L", n );
+#endif
+}
+
+PyObject *pgn_close ( PyObject *self, PyObject *args ) {
+	int h;
+	PyArg_ParseTuple( args,  "i", &h );
+	if(h>=0 && h<LIB_PGN_MAX && lib_pgn[h]!=NULL) {
+		PgnClose( lib_pgn[h] );
+		free( lib_pgn[h] );
+		lib_pgn[h] = NULL;
+	}
+	return Py_BuildValue( "", NULL );
+}
+
+// compact games, one byte per move
+
+PyObject *game_encode ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	char *ucisstr;
+	U8 mvs[PGN_PLIES];
+	if(!PyArg_ParseTuple( args,  "s", &ucisstr )) return NULL;
+	int n = GameEncode( ucisstr, mvs, PGN_PLIES );
+	if(n<0) {
+		PyErr_Format( PyExc_ValueError, "move not legal or more than %d moves", PGN_PLIES );
+		return NULL;
+	}
+	return PyBytes_FromStringAndSize( (char *)mvs, n );
+}
+
+PyObject *game_decode ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	Py_buffer b;
+	if(!PyArg_ParseTuple( args,  "y*", &b )) return NULL;
+	GameDecode( (U8 *)b.buf, (int)b.len, lib_buffer, sizeof(lib_buffer) );
+	PyBuffer_Release( &b );
+	return Py_BuildValue( "s", lib_buffer );
+}
+
+// writes games file of PGN file or of list of uci strings / (ucis, result)
+PyObject *games_write ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	char *out, *ucis, *res;
+	PyObject *src, *seq, *it;
+	GameWriter w;
+	U8 mvs[PGN_PLIES];
+	Py_ssize_t i;
+	long long cnt = 0;
+	int n;
+
+	if(!PyArg_ParseTuple( args,  "sO", &out, &src )) return NULL;
+	if(!GamesCreate( &w, out )) return PyErr_SetFromErrnoWithFilename( PyExc_OSError, out );
+
+	lib_enter();
+	if(PyUnicode_Check(src)) {
+		char *pgn = (char *)PyUnicode_AsUTF8(src);
+		Py_BEGIN_ALLOW_THREADS
+		cnt = GamesFromPgn( &w, pgn );
+		Py_END_ALLOW_THREADS
+	}
+	else {
+		seq = PySequence_Fast( src, "games should be PGN file name or list" );
+		if(seq==NULL) cnt = -2;
+		else {
+			for(i=0; i<PySequence_Fast_GET_SIZE(seq); i++) {
+				it = PySequence_Fast_GET_ITEM(seq,i);
+				res = NULL;
+				if(PyTuple_Check(it)) {
+					if(!PyArg_ParseTuple( it, "s|s", &ucis, &res )) { cnt = -2; break; }
+				}
+				else if((ucis = (char *)PyUnicode_AsUTF8(it))==NULL) { cnt = -2; break; }
+				SetStartPos();
+				n = GameEncode( ucis, mvs, PGN_PLIES );
+				if(n<0) {
+					PyErr_Format( PyExc_ValueError, "game %zd: move not legal or more than %d moves", i, PGN_PLIES );
+					cnt = -2;
+					break;
+				}
+				if(!GamesAdd( &w, GameResult( res ), NULL, mvs, n )) { cnt = -1; break; }
+				cnt++;
+			}
+			Py_DECREF(seq);
+		}
+	}
+	lib_leave();
+	if(GamesFinish( &w )<0 && cnt>=0) cnt = -1;
+	if(cnt==-2) return NULL;
+	if(cnt<0) return PyErr_SetFromErrno( PyExc_OSError );
+	return Py_BuildValue( "L", cnt );
+}
+
+#define LIB_GAMES_MAX 8
+GameFile *lib_games[LIB_GAMES_MAX];
+
+PyObject *games_open ( PyObject *self, PyObject *args ) {
+	char *path;
+	int h;
+	if(!PyArg_ParseTuple( args,  "s", &path )) return NULL;
+	for(h=0; h<LIB_GAMES_MAX && lib_games[h]!=NULL; h++);
+	if(h==LIB_GAMES_MAX) return Py_BuildValue( "i", -1 );
+	GameFile *g = (GameFile *)malloc( sizeof(GameFile) );
+	if(g==NULL) return Py_BuildValue( "i", -1 );
+	if(!GamesOpen( g, path )) {
+		free(g);
+		return Py_BuildValue( "i", -1 );
+	}
+	lib_games[h] = g;
+	return Py_BuildValue( "i", h );
+}
+
+PyObject *games_count ( PyObject *self, PyObject *args ) {
+	int h;
+	PyArg_ParseTuple( args,  "i", &h );
+	if(h<0 || h>=LIB_GAMES_MAX || lib_games[h]==NULL) return Py_BuildValue( "i", -1 );
+	return Py_BuildValue( "L", lib_games[h]->n );
+}
+
+// game i as (result, ucis) or None, board is at the end of game
+PyObject *games_get ( PyObject *self, PyObject *args ) {
+	LIB_BOARD_SET
+	int h, r;
+	long long i;
+	if(!PyArg_ParseTuple( args,  "iL", &h, &i )) return NULL;
+	if(h<0 || h>=LIB_GAMES_MAX || lib_games[h]==NULL) Py_RETURN_NONE;
+	r = GamesPlay( lib_games[h], i, lib_buffer, sizeof(lib_buffer) );
+	if(r<0) Py_RETURN_NONE;
+	return Py_BuildValue( "(ss)", game_results[r], lib_buffer );
+}
+
+PyObject *games_close ( PyObject *self, PyObject *args ) {
+	int h;
+	PyArg_ParseTuple( args,  "i", &h );
+	if(h>=0 && h<LIB_GAMES_MAX && lib_games[h]!=NULL) {
+		GamesClose( lib_games[h] );
+		free( lib_games[h] );
+		lib_games[h] = NULL;
+	}
+	return Py_BuildValue( "", NULL );
+}
+
+// position database, values by polyglot key
+
+// keys of list of ints or buffer of U64, malloc-ed, n gets count
+U64 *libKeys( PyObject *o, Py_ssize_t *n ) {
+	U64 *k;
+	Py_ssize_t i;
+	Py_buffer b;
+	if(PyObject_CheckBuffer(o) && PyObject_GetBuffer( o, &b, PyBUF_SIMPLE )==0) {
+		*n = b.len/8;
+		k = (U64 *)malloc( (*n+1)*8 );
+		if(k!=NULL) memcpy( k, b.buf, (*n)*8 );
+		PyBuffer_Release( &b );
+	}
+	else {
+		PyObject *seq = PySequence_Fast( o, "keys should be list of ints or bytes" );
+		if(seq==NULL) return NULL;
+		*n = PySequence_Fast_GET_SIZE(seq);
+		k = (U64 *)malloc( (*n+1)*8 );
+		for(i=0; k!=NULL && i<*n; i++) k[i] = PyLong_AsUnsignedLongLongMask( PySequence_Fast_GET_ITEM(seq,i) );
+		Py_DECREF(seq);
+	}
+	if(k==NULL) PyErr_NoMemory();
+	else if(PyErr_Occurred()) { free(k); k = NULL; }
+	return k;
+}
+
+PyObject *posdb_build ( PyObject *self, PyObject *args ) {
+	char *path;
+	PyObject *keys;
+	Py_buffer v;
+	Py_ssize_t n;
+	int rec;
+	long long cnt;
+	if(!PyArg_ParseTuple( args,  "sOy*i", &path, &keys, &v, &rec )) return NULL;
+	U64 *k = libKeys( keys, &n );
+	if(k==NULL) { PyBuffer_Release( &v ); return NULL; }
+	if(rec<0 || v.len < (Py_ssize_t)n*rec) {
+		free(k);
+		PyBuffer_Release( &v );
+		PyErr_SetString( PyExc_ValueError, "values should be count of keys * record size bytes" );
+		return NULL;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	cnt = PosDbBuild( path, k, (U8 *)v.buf, n, rec );
+	Py_END_ALLOW_THREADS
+	free(k);
+	PyBuffer_Release( &v );
+	if(cnt<0) return PyErr_SetFromErrnoWithFilename( PyExc_OSError, path );
+	return Py_BuildValue( "L", cnt );
+}
+
+#define LIB_POSDB_MAX 8
+PosDb *lib_posdb[LIB_POSDB_MAX];
+
+PosDb *libPosDb( int h ) {
+	return ((h>=0 && h<LIB_POSDB_MAX) ? lib_posdb[h] : NULL);
+}
+
+PyObject *posdb_open ( PyObject *self, PyObject *args ) {
+	char *path;
+	int h;
+	if(!PyArg_ParseTuple( args,  "s", &path )) return NULL;
+	for(h=0; h<LIB_POSDB_MAX && lib_posdb[h]!=NULL; h++);
+	if(h==LIB_POSDB_MAX) return Py_BuildValue( "i", -1 );
+	PosDb *d = (PosDb *)malloc( sizeof(PosDb) );
+	if(d==NULL) return Py_BuildValue( "i", -1 );
+	if(!PosDbOpen( d, path )) {
+		free(d);
+		return Py_BuildValue( "i", -1 );
+	}
+	lib_posdb[h] = d;
+	return Py_BuildValue( "i", h );
+}
+
+// value of key (current position if not given) as bytes or None
+PyObject *posdb_get ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int h;
+	PyObject *ko = NULL;
+	if(!PyArg_ParseTuple( args,  "i|O", &h, &ko )) return NULL;
+	PosDb *d = libPosDb(h);
+	if(d==NULL) Py_RETURN_NONE;
+	U64 key = (ko==NULL ? getPolyglotKey() : PyLong_AsUnsignedLongLongMask( ko ));
+	if(PyErr_Occurred()) return NULL;
+	const U8 *v = PosDbGet( d, key );
+	if(v==NULL) Py_RETURN_NONE;
+	return PyBytes_FromStringAndSize( (char *)v, d->rec );
+}
+
+// values of keys as list of bytes or None
+PyObject *posdb_get_many ( PyObject *self, PyObject *args ) {
+	int h;
+	PyObject *keys;
+	Py_ssize_t i, n;
+	if(!PyArg_ParseTuple( args,  "iO", &h, &keys )) return NULL;
+	PosDb *d = libPosDb(h);
+	if(d==NULL) Py_RETURN_NONE;
+	U64 *k = libKeys( keys, &n );
+	if(k==NULL) return NULL;
+	const U8 **v = (const U8 **)malloc( (n+1)*sizeof(U8 *) );
+	if(v==NULL) { free(k); return PyErr_NoMemory(); }
+	Py_BEGIN_ALLOW_THREADS
+	for(i=0; i<n; i++) v[i] = PosDbGet( d, k[i] );
+	Py_END_ALLOW_THREADS
+	PyObject *list = PyList_New(n);
+	for(i=0; i<n; i++) {
+		if(v[i]==NULL) { Py_INCREF(Py_None); PyList_SET_ITEM( list, i, Py_None ); }
+		else PyList_SET_ITEM( list, i, PyBytes_FromStringAndSize( (char *)v[i], d->rec ) );
+	}
+	free(v);
+	free(k);
+	return list;
+}
+
+PyObject *posdb_close ( PyObject *self, PyObject *args ) {
+	int h;
+	PyArg_ParseTuple( args,  "i", &h );
+	PosDb *d = libPosDb(h);
+	if(d!=NULL) {
+		PosDbClose( d );
+		free( d );
+		lib_posdb[h] = NULL;
+	}
+	return Py_BuildValue( "", NULL );
+}
+
+// endgame tables: win-draw-loss -2..2 of side to move or None if not in tables
+PyObject *tbprobe ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int v = TbProbeWDL();
+	if(v==TB_NONE) return Py_BuildValue( "", NULL );
+	return Py_BuildValue( "i", v );
+}
+
+// distance to zeroing move in plies, +win -loss, or None
+PyObject *tbdtz ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int v = TbProbeDTZ();
+	if(v==TB_NONE) return Py_BuildValue( "", NULL );
+	return Py_BuildValue( "i", v );
+}
+
+// best move by tables as (uci, wdl after move) or None
+PyObject *tbroot ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	U8 mv[4];
+	char uci[8];
+	int v = TbRootMove( mv );
+	if(v==TB_NONE) return Py_BuildValue( "", NULL );
+	uci[0] = ((mv[1]&7)+'a'); uci[1] = ((mv[1]>>3)+'1');
+	uci[2] = ((mv[2]&7)+'a'); uci[3] = ((mv[2]>>3)+'1');
+	uci[4] = ((mv[3]&2) ? pieces[8+((mv[3]>>2)&3)] : 0);
+	uci[5] = 0;
+	return Py_BuildValue( "(si)", uci, v );
+}
+
+// generates bitbases "KPK KRK KQK", returns bytes of memory or 0 if unknown
+PyObject *bitbase_build ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	char *sigs = "KPK";
+	if(!PyArg_ParseTuple( args, "|s", &sigs )) return NULL;
+	return Py_BuildValue( "i", BitbaseBuild( sigs ) );
+}
+
+// Syzygy .rtbw/.rtbz files of directories "dir1:dir2", returns count of WDL tables
+PyObject *syzygy_init ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	char *paths;
+	if(!PyArg_ParseTuple( args, "s", &paths )) return NULL;
+	return Py_BuildValue( "i", SyzygyInit( paths ) );
+}
+
+// moves mating in n or less as list of (uci, moves to mate), checks=1 only check+ moves
+PyObject *solve_mate ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int n, checks = 0, i, found;
+	U8 mvs[4<<8], moves[256], *p;
+	char uci[8];
+	if(!PyArg_ParseTuple( args, "i|i", &n, &checks )) return NULL;
+	if(n<1) n = 1;
+
+	lib_enter();
+	Py_BEGIN_ALLOW_THREADS
+	found = SolveMate( (U8)(n>MATE_MAX ? MATE_MAX : n), (U8)(checks ? 1 : 0), mvs, moves );
+	Py_END_ALLOW_THREADS
+	lib_leave();
+
+	if(found<0) return PyErr_NoMemory();
+	PyObject *list = PyList_New(found);
+	for(i=0, p=mvs; i<found; i++, p+=4) {
+		uci[0] = ((p[1]&7)+'a'); uci[1] = ((p[1]>>3)+'1');
+		uci[2] = ((p[2]&7)+'a'); uci[3] = ((p[2]>>3)+'1');
+		uci[4] = ((p[3]&2) ? pieces[8+((p[3]>>2)&3)] : 0);
+		uci[5] = 0;
+		PyList_SET_ITEM(list, i, Py_BuildValue( "(si)", uci, moves[i] ) );
+	}
+	return list;
+}
+
+// random playouts of current position as (win, draw, loss, unfinished, plies) of side to move
+PyObject *playouts ( PyObject *self, PyObject *args, PyObject *kw ) {
+	LIB_BOARD
+	static char *kws[] = { "n", "max_plies", "policy", "workers", "seed", NULL };
+	long long n;
+	int maxply = 200, workers = 0;
+	char *policy = "uniform";
+	unsigned long long seed = 0;
+	U8 po;
+	PlayoutStats st;
+
+	if(!PyArg_ParseTupleAndKeywords( args, kw, "L|isiK", kws, &n, &maxply, &policy, &workers, &seed )) return NULL;
+	if(strcmp( policy, "uniform" )==0) po = PO_UNIFORM;
+	else if(strcmp( policy, "captures" )==0) po = PO_CAPTURES;
+	else {
+		PyErr_SetString( PyExc_ValueError, "policy should be 'uniform' or 'captures'" );
+		return NULL;
+	}
+	if(seed==0) seed = ((U64)time(NULL)<<20) ^ (U64)clock() ^ po_rnd;
+
+	lib_enter();
+	Py_BEGIN_ALLOW_THREADS
+	PlayoutsRun( (n>0 ? n : 0), maxply, po, workers, (U64)seed, &st );
+	Py_END_ALLOW_THREADS
+	lib_leave();
+
+	return Py_BuildValue( "(LLLLL)", st.win, st.draw, st.loss, st.unfinished, st.plies );
+}
+
+// copies float32 or float64 buffer of n items into f, 0 on error
+int lib_floats( PyObject *o, float *f, int n ) {
+	Py_buffer v;
+	int i;
+	if(PyObject_GetBuffer( o, &v, PyBUF_C_CONTIGUOUS|PyBUF_FORMAT )<0) return 0;
+	if(v.format!=NULL && strcmp( v.format, "d" )==0 && v.len>=(Py_ssize_t)n*8) {
+		for(i=0; i<n; i++) f[i] = (float)((double *)v.buf)[i];
+	}
+	else if((v.format==NULL || strcmp( v.format, "f" )==0) && v.len>=(Py_ssize_t)n*4) {
+		memcpy( f, v.buf, n*sizeof(float) );
+	}
+	else {
+		PyBuffer_Release( &v );
+		PyErr_Format( PyExc_ValueError, "expected %d float32 or float64 values", n );
+		return 0;
+	}
+	PyBuffer_Release( &v );
+	return 1;
+}
+
+// one Python call per batch: callback(planes, n) -> (policy, value)
+int lib_mcts_eval( void *arg, float *planes, int n, float *policy, float *value ) {
+	PyObject *mv, *r;
+	int ok;
+	mv = PyMemoryView_FromMemory( (char *)planes, (Py_ssize_t)n*MCTS_PLANES*64*sizeof(float), PyBUF_READ );
+	if(mv==NULL) return 0;
+	lib_callback++;
+	r = PyObject_CallFunction( (PyObject *)arg, "Oi", mv, n );
+	lib_callback--;
+	Py_DECREF(mv);
+	if(r==NULL) return 0;
+	ok = (PyTuple_Check(r) && PyTuple_GET_SIZE(r)==2);
+	if(!ok) PyErr_SetString( PyExc_TypeError, "callback should return (policy, value)" );
+	ok = ok && lib_floats( PyTuple_GET_ITEM(r,0), policy, n*MCTS_POLICY ) &&
+		lib_floats( PyTuple_GET_ITEM(r,1), value, n );
+	Py_DECREF(r);
+	return ok;
+}
+
+// PUCT search of current position, returns (value, [(uci, visits, q, prior), ...])
+PyObject *mcts_search ( PyObject *self, PyObject *args, PyObject *kw ) {
+	LIB_BOARD
+	static char *kws[] = { "callback", "sims", "batch", "cpuct", "max_nodes", "workers", NULL };
+	PyObject *cb, *list;
+	int sims, batch = 8, nodes = 200000, workers = 1, i, done;
+	float cpuct = 1.5f;
+	char uci[8];
+	Mcts t;
+	MctsNode *c, *root;
+
+	if(!PyArg_ParseTupleAndKeywords( args, kw, "Oi|ifii", kws, &cb, &sims, &batch, &cpuct, &nodes, &workers )) return NULL;
+	if(!PyCallable_Check(cb)) {
+		PyErr_SetString( PyExc_TypeError, "callback should be callable" );
+		return NULL;
+	}
+	if(!MctsInit( &t, nodes, cpuct )) return PyErr_NoMemory();
+	lib_enter();
+	done = MctsSearch( &t, sims, batch, workers, lib_mcts_eval, cb );
+	lib_leave();
+	if(done<0) {
+		MctsFree( &t );
+		if(done==-2 && !PyErr_Occurred()) PyErr_SetString( PyExc_RuntimeError, "mcts_search callback moved the board" );
+		if(!PyErr_Occurred()) PyErr_NoMemory();
+		return NULL;
+	}
+	root = t.nodes;
+	list = PyList_New(0);
+	for(i=0, c=&t.nodes[root->child]; root->state==MCTS_EXPANDED && i<root->nchild; i++, c++) {
+		uci[0] = ((c->mv[1]&7)+'a'); uci[1] = ((c->mv[1]>>3)+'1');
+		uci[2] = ((c->mv[2]&7)+'a'); uci[3] = ((c->mv[2]>>3)+'1');
+		uci[4] = ((c->mv[3]&2) ? pieces[8+((c->mv[3]>>2)&3)] : 0);
+		uci[5] = 0;
+		PyObject *e = Py_BuildValue( "(sidd)", uci, c->n, (c->n ? (double)c->w/c->n : 0.0), (double)c->prior );
+		PyList_Append( list, e );
+		Py_DECREF(e);
+	}
+	PyObject *res = Py_BuildValue( "(dO)", (root->n ? -(double)root->w/root->n : 0.0), list );
+	Py_DECREF(list);
+	MctsFree( &t );
+	return res;
+}
+
+// best move of side to move by uci, NULL if none
+U8 *lib_ord_best( char *ucistr, U8 *mv ) {
+	if( ucistr==NULL || !uciToMv( ucistr, mv ) || !IsPseudoLegal( mv ) ) return NULL;
+	return mv;
+}
+
+// opponent's last move by uci, already made, piece and to-square for counter-moves
+U8 *lib_ord_prev( char *ucistr, U8 *mv ) {
+	if( ucistr==NULL || !uciValid( ucistr ) ) return NULL;
+	mv[2] = (((ucistr[3]-'1')<<3)|(ucistr[2]-'a'));
+	mv[0] = PieceAt( mv[2] );
+	return (mv[0]==6 ? NULL : mv);
+}
+
+// legal moves in search order, list of (uci, score)
+PyObject *ordermoves ( PyObject *self, PyObject *args, PyObject *kw ) {
+	LIB_BOARD
+	static char *kws[] = { "ply", "best", "prev", NULL };
+	int ply = 0, i = 0;
+	char *bs = NULL, *ps = NULL, uci[8];
+	U8 b[4], pv[4], *p;
+	MovePicker mp;
+	if(!PyArg_ParseTupleAndKeywords( args, kw, "|izz", kws, &ply, &bs, &ps )) return NULL;
+
+	MoveGen( (U8 *)lib_mv );
+	PickerInit( &mp, (U8 *)lib_mv+1, (U8)lib_mv[0], ply, lib_ord_best( bs, b ), lib_ord_prev( ps, pv ) );
+	PyObject *list = PyList_New(mp.cnt);
+	while( (p = PickNext( &mp ))!=NULL ) {
+		uci[0] = ((p[1]&7)+'a'); uci[1] = ((p[1]>>3)+'1');
+		uci[2] = ((p[2]&7)+'a'); uci[3] = ((p[2]>>3)+'1');
+		uci[4] = ((p[3]&2) ? pieces[8+((p[3]>>2)&3)] : 0);
+		uci[5] = 0;
+		PyList_SET_ITEM(list, i, Py_BuildValue( "(si)", uci, mp.score[i] ) );
+		i++;
+	}
+	return list;
+}
+
+// quiet move of side to move caused beta cut-off: killers, counter-move, history
+PyObject *order_cutoff ( PyObject *self, PyObject *args, PyObject *kw ) {
+	LIB_BOARD
+	static char *kws[] = { "uci", "ply", "depth", "prev", NULL };
+	int ply, dep;
+	char *ucistr, *ps = NULL;
+	U8 mv[4], pv[4];
+	if(!PyArg_ParseTupleAndKeywords( args, kw, "sii|z", kws, &ucistr, &ply, &dep, &ps )) return NULL;
+	if( uciToMv( ucistr, mv ) && IsPseudoLegal( mv ) ) OrderCutoff( mv, ply, dep, lib_ord_prev( ps, pv ) );
+	Py_RETURN_NONE;
+}
+
+PyObject *order_clear ( PyObject *self, PyObject *args ) {
+	OrderClear();
+	Py_RETURN_NONE;
+}
+
+// callback(ply, uci of last move or None, leaf), False skips moves of node
+int lib_walk_visit( void *arg, int ply, U8 *path, U8 leaf ) {
+	char uci[8];
+	U8 *p = path+((ply-1)<<2);
+	PyObject *r;
+	if(ply>0) {
+		uci[0] = ((p[1]&7)+'a'); uci[1] = ((p[1]>>3)+'1');
+		uci[2] = ((p[2]&7)+'a'); uci[3] = ((p[2]>>3)+'1');
+		uci[4] = ((p[3]&2) ? pieces[8+((p[3]>>2)&3)] : 0);
+		uci[5] = 0;
+	}
+	lib_callback++;
+	r = PyObject_CallFunction( (PyObject *)arg, "izO", ply, (ply>0 ? uci : NULL), (leaf ? Py_True : Py_False) );
+	lib_callback--;
+	if(r==NULL) return 0;
+	int ret = (r==Py_False ? 2 : 1);
+	Py_DECREF(r);
+	return ret;
+}
+
+U8 lib_walking = 0;
+
+PyObject *walk ( PyObject *self, PyObject *args, PyObject *kw ) {
+	LIB_BOARD
+	static char *kws[] = { "depth", "callback", "moves", "material", "interior", NULL };
+	CONST char *mvs[] = { "all", "captures", "checks", "tactical" };
+	int dep, material = 0, interior = 0, m;
+	char *mstr = "all";
+	PyObject *cb = Py_None;
+	WalkStats st;
+	long long r;
+	if(!PyArg_ParseTupleAndKeywords( args, kw, "i|Osip", kws, &dep, &cb, &mstr, &material, &interior )) return NULL;
+	for(m=0; m<4 && strcmp( mstr, mvs[m] )!=0; m++);
+	if(m==4) {
+		PyErr_SetString( PyExc_ValueError, "moves should be 'all', 'captures', 'checks' or 'tactical'" );
+		return NULL;
+	}
+	if(cb!=Py_None && !PyCallable_Check(cb)) {
+		PyErr_SetString( PyExc_TypeError, "callback should be callable or None" );
+		return NULL;
+	}
+	if(lib_walking) {
+		PyErr_SetString( PyExc_RuntimeError, "walk is running" );
+		return NULL;
+	}
+	lib_walking = 1;
+	lib_enter();
+	if(interior) m |= WALK_INTERIOR;
+	if(cb==Py_None) {
+		Py_BEGIN_ALLOW_THREADS
+		r = Walk( dep, (U8)m, material, NULL, NULL, &st );
+		Py_END_ALLOW_THREADS
+	}
+	else r = Walk( dep, (U8)m, material, lib_walk_visit, cb, &st );
+	lib_leave();
+	lib_walking = 0;
+
+	if(PyErr_Occurred()) return NULL;
+	if(r==-2) {
+		PyErr_SetString( PyExc_RuntimeError, "walk callback moved the board" );
+		return NULL;
+	}
+	if(r<0) return PyErr_NoMemory();
+	return Py_BuildValue( "(LLL)", st.nodes, st.leaves, st.visits );
+}
+
+// (status, halfmove clock, fullmove number, repetitions of position)
+PyObject *gamestatus ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	CONST char *st[] = { "ongoing", "checkmate", "stalemate", "insufficient", "threefold", "fifty" };
+	U8 s = GameStatus();
+	return Py_BuildValue( "(siii)", st[s], HalfMoves, FullMoves, Repetitions() );
+}
+
 PyObject *ischeck ( PyObject *self, PyObject *args ) {
-	return ( IsCheckNow() ? Py_True : Py_False );
+	LIB_BOARD
+	if(IsCheckNow()) Py_RETURN_TRUE;
+	Py_RETURN_FALSE;
 }
 
 PyObject *ischeckmate ( PyObject *self, PyObject *args ) {
-	return ( IsCheckMateNow() ? Py_True : Py_False );
+	LIB_BOARD
+	if(IsCheckMateNow()) Py_RETURN_TRUE;
+	Py_RETURN_FALSE;
 }
 
 PyObject *polyglotkey ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	return Py_BuildValue( "K", getPolyglotKey() );
 }
 
+// Polyglot books, mapped read-only
+
+#define LIB_BOOK_MAX 8
+PolyBook *lib_book[LIB_BOOK_MAX];
+U64 lib_book_rnd = 0x9E3779B97F4A7C15LL;	// xorshift state for picks
+
+PolyBook *libBook( int h ) {
+	return ((h>=0 && h<LIB_BOOK_MAX) ? lib_book[h] : NULL);
+}
+
+PyObject *book_open ( PyObject *self, PyObject *args ) {
+	char *path;
+	int h;
+	if(!PyArg_ParseTuple( args,  "s", &path )) return NULL;
+	for(h=0; h<LIB_BOOK_MAX && lib_book[h]!=NULL; h++);
+	if(h==LIB_BOOK_MAX) return Py_BuildValue( "i", -1 );
+
+	PolyBook *b = (PolyBook *)malloc( sizeof(PolyBook) );
+	if(b==NULL) return Py_BuildValue( "i", -1 );
+	if(!BookOpen( b, path )) {
+		free(b);
+		return Py_BuildValue( "i", -1 );
+	}
+	lib_book[h] = b;
+	lib_book_rnd ^= ((U64)time(NULL)<<16) ^ (U64)(size_t)b;
+	return Py_BuildValue( "i", h );
+}
+
+// moves of current position as list of (uci, weight, learn)
+PyObject *book_moves ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int h, i, n;
+	PolyMove mvs[BOOK_MOVES];
+	PyArg_ParseTuple( args,  "i", &h );
+	PolyBook *b = libBook(h);
+	if(b==NULL) Py_RETURN_NONE;
+	n = BookMoves( b, mvs );
+	PyObject *list = PyList_New(n);
+	for(i=0; i<n; i++) {
+		PyList_SET_ITEM( list, i, Py_BuildValue( "(sII)", mvs[i].uci, (U32)mvs[i].weight, mvs[i].learn ) );
+	}
+	return list;
+}
+
+// weighted random book move of current position or None, r in [0,1) optional
+PyObject *book_pick ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int h;
+	double r = -1.0;
+	U32 rnd;
+	char uci[8];
+	PyArg_ParseTuple( args,  "i|d", &h, &r );
+	PolyBook *b = libBook(h);
+	if(b==NULL) Py_RETURN_NONE;
+	if(r>=0.0 && r<1.0) rnd = (U32)(r*4294967296.0);
+	else {
+		lib_book_rnd ^= lib_book_rnd<<13;
+		lib_book_rnd ^= lib_book_rnd>>7;
+		lib_book_rnd ^= lib_book_rnd<<17;
+		rnd = (U32)(lib_book_rnd>>32);
+	}
+	if(!BookPick( b, rnd, uci )) Py_RETURN_NONE;
+	return Py_BuildValue( "s", uci );
+}
+
+// builds book of PGN file(s), returns count of entries
+PyObject *book_build ( PyObject *self, PyObject *args, PyObject *kw ) {
+	LIB_BOARD_SET
+	static char *kws[] = { "pgn", "out", "max_ply", "min_games", "mem_mb", NULL };
+	PyObject *pgn, *seq;
+	char *out, **paths;
+	int maxply = 60, mingames = 1, memmb = 256, n, i;
+	long long cnt;
+
+	if(!PyArg_ParseTupleAndKeywords( args, kw, "Os|iii", kws, &pgn, &out, &maxply, &mingames, &memmb )) return NULL;
+	if(PyUnicode_Check(pgn)) seq = Py_BuildValue( "(O)", pgn );
+	else seq = PySequence_Fast( pgn, "pgn should be file name or list of them" );
+	if(seq==NULL) return NULL;
+	n = (int)PySequence_Fast_GET_SIZE(seq);
+	paths = (char **)PyMem_Malloc( (n>0 ? n : 1)*sizeof(char *) );
+	if(paths==NULL) { Py_DECREF(seq); return PyErr_NoMemory(); }
+	for(i=0; i<n; i++) {
+		paths[i] = (char *)PyUnicode_AsUTF8( PySequence_Fast_GET_ITEM(seq,i) );
+		if(paths[i]==NULL) { PyMem_Free(paths); Py_DECREF(seq); return NULL; }
+	}
+	lib_enter();
+	Py_BEGIN_ALLOW_THREADS
+	cnt = BookBuild( paths, n, out, maxply, mingames, memmb );
+	Py_END_ALLOW_THREADS
+	lib_leave();
+	PyMem_Free(paths);
+	Py_DECREF(seq);
+	if(cnt<0) return PyErr_SetFromErrno( PyExc_OSError );
+	return Py_BuildValue( "L", cnt );
+}
+
+PyObject *book_close ( PyObject *self, PyObject *args ) {
+	int h;
+	PyArg_ParseTuple( args,  "i", &h );
+	PolyBook *b = libBook(h);
+	if(b!=NULL) {
+		BookClose( b );
+		free( b );
+		lib_book[h] = NULL;
+	}
+	return Py_BuildValue( "", NULL );
+}
 
-// Freak mode. Iterations in depth
 
+// Freak mode. Iterations in depth
+// walk() does whole subtrees without Python calls per node
+
+// depth argument, with a move left at depth if mv
+U8 lib_ii_depth( PyObject *args, U8 mv ) {
+	U8 *dp;
+	if(!PyArg_ParseTuple( args,  "i", &depth )) return 0;
+	if(depth<0 || depth>=LIB_II_DEPTH) {
+		PyErr_Format( PyExc_IndexError, "depth should be 0..%d", LIB_II_DEPTH-1 );
+		return 0;
+	}
+	dp = (U8 *)&lib_ii_mv[(4<<8)*depth];
+	if(mv && (lib_ii_po[depth]==NULL || lib_ii_po[depth] >= dp+1+(dp[0]<<2))) {
+		PyErr_SetString( PyExc_IndexError, "no moves left at depth" );
+		return 0;
+	}
+	return 1;
+}
 
 PyObject *i_movegen ( PyObject *self, PyObject *args ) {
-	PyArg_ParseTuple( args,  "i", &depth );
+	LIB_BOARD
+	if(!lib_ii_depth( args, 0 )) return NULL;
 	
 	U8 *dp = &lib_ii_mv[(4<<8)*depth];
 	
@@ -462,7 +1395,8 @@ PyObject *i_movegen ( PyObject *self, PyObject *args ) {
 
 
 PyObject *i_domove ( PyObject *self, PyObject *args ) {
-	PyArg_ParseTuple( args,  "i", &depth );
+	LIB_BOARD_SET
+	if(!lib_ii_depth( args, 1 )) return NULL;
 	
 	DoMove( lib_ii_po[depth] );
 	lib_ii_po[depth]+=4;
@@ -493,6 +1427,7 @@ PyObject *Tu( U64 o ) {
 
 // get current board in object
 PyObject *getboard ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 
 	return Py_BuildValue( "{s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:O,s:i,s:i}",
 		"wk", Tu(WK), "wq", Tu(WQ), "wr",	Tu(WR),		"wb", Tu(WB), "wn", Tu(WN), "wp", Tu(WP),
@@ -503,6 +1438,7 @@ PyObject *getboard ( PyObject *self, PyObject *args ) {
 
 // get current board in object
 PyObject *getboardU64 ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	return Py_BuildValue( "(KKKKKKKKKKKKii)",
 		WK,WQ,WR,WB,WN,WP,BK,BQ,BR,BB,BN,BP, ToMove, trail0(ENPSQ) );
 }
@@ -510,6 +1446,7 @@ PyObject *getboardU64 ( PyObject *self, PyObject *args ) {
 
 // get information on possible castlings
 PyObject *getcastlings ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 
 	return Py_BuildValue( "{s:i,s:i,s:i,s:i}",
 		"e1c1", ( ((CASTLES&castle_E1C1)==castle_E1C1) ? 1 : 0),
@@ -520,6 +1457,7 @@ PyObject *getcastlings ( PyObject *self, PyObject *args ) {
 
 // get information on possible castlings
 PyObject *getcastlingsU64 ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 
 	return Py_BuildValue( "(iiii)",
 		( ((CASTLES&castle_E1C1)==castle_E1C1) ? 1 : 0),
@@ -530,6 +1468,7 @@ PyObject *getcastlingsU64 ( PyObject *self, PyObject *args ) {
 
 // get occupancies information
 PyObject *getoccupancies ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 
     WOCC = WK|WQ|WR|WB|WN|WP;
     BOCC = BK|BQ|BR|BB|BN|BP;
@@ -548,6 +1487,7 @@ PyObject *getoccupancies ( PyObject *self, PyObject *args ) {
 
 // get occupancies information
 PyObject *getoccupanciesU64 ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	
     WOCC = WK|WQ|WR|WB|WN|WP;
     BOCC = BK|BQ|BR|BB|BN|BP;
@@ -563,9 +1503,72 @@ PyObject *getoccupanciesU64 ( PyObject *self, PyObject *args ) {
 		OCC, WOCC, BOCC, NOCC, NWOCC, NBOCC, EOCC, EWOCC, EBOCC );
 }
 
+// create a tuple of 64 values, one per square
+PyObject *Tu64( U8 *a ) {
+
+	PyObject *tuple = PyTuple_New(64);
+	for(int i=0; i<64; i++)
+	{
+		PyTuple_SET_ITEM(tuple, i, PyLong_FromLong( a[i] ) );
+	}
+	return tuple;
+}
+
+// get squares attacked by whites and blacks
+PyObject *getattacks ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+
+	return Py_BuildValue( "{s:O,s:O}",
+		"white", Tu(AttacksBySide(0)), "black", Tu(AttacksBySide(1)) );
+}
+
+// get attacks into unsigned long long (fast)
+PyObject *getattacksU64 ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+
+	return Py_BuildValue( "(KK)", AttacksBySide(0), AttacksBySide(1) );
+}
+
+// get pieces attacking square
+PyObject *attackers ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int sq;
+	PyArg_ParseTuple( args,  "i", &sq );
+
+	WOCC = WK|WQ|WR|WB|WN|WP;
+	BOCC = BK|BQ|BR|BB|BN|BP;
+	OCC = WOCC|BOCC;
+	U64 a = AttackersTo( (U8)(sq&63), OCC );
+
+	return Py_BuildValue( "{s:O,s:O}",
+		"white", Tu(a&WOCC), "black", Tu(a&BOCC) );
+}
+
+PyObject *attackersU64 ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	int sq;
+	PyArg_ParseTuple( args,  "i", &sq );
+
+	WOCC = WK|WQ|WR|WB|WN|WP;
+	BOCC = BK|BQ|BR|BB|BN|BP;
+	OCC = WOCC|BOCC;
+	U64 a = AttackersTo( (U8)(sq&63), OCC );
+
+	return Py_BuildValue( "(KK)", a&WOCC, a&BOCC );
+}
+
+// count of white and black attackers for each square
+PyObject *attackcounts ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	U8 wcnt[64], bcnt[64];
+	AttackCounts( wcnt, bcnt );
+	return Py_BuildValue( "(NN)", Tu64(wcnt), Tu64(bcnt) );
+}
+
 // get more data on current move to iterate 
 PyObject *i_moveinfo ( PyObject *self, PyObject *args ) {
-	PyArg_ParseTuple( args,  "i", &depth );
+	LIB_BOARD
+	if(!lib_ii_depth( args, 1 )) return NULL;
 	
 	U8 *p = lib_ii_po[depth];
 	
@@ -599,7 +1602,8 @@ PyObject *i_moveinfo ( PyObject *self, PyObject *args ) {
 
 // get more data on current move to iterate 
 PyObject *i_moveinfoU64 ( PyObject *self, PyObject *args ) {
-	PyArg_ParseTuple( args,  "i", &depth );
+	LIB_BOARD
+	if(!lib_ii_depth( args, 1 )) return NULL;
 	
 	U8 *p = lib_ii_po[depth];
 	
@@ -620,8 +1624,34 @@ PyObject *i_moveinfoU64 ( PyObject *self, PyObject *args ) {
 		t1, t2, f_sq, t_sq, capt, pr, pr_pc, ecapt, cs, ck, cm );
 }
 
+// SEE of current move to iterate
+PyObject *i_see ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
+	if(!lib_ii_depth( args, 1 )) return NULL;
+	return Py_BuildValue( "i", SEE( lib_ii_po[depth] ) );
+}
+
+// orders moves left to iterate at depth, as ordermoves, returns count of them
+PyObject *i_order ( PyObject *self, PyObject *args, PyObject *kw ) {
+	LIB_BOARD
+	static char *kws[] = { "depth", "ply", "best", "prev", NULL };
+	int d, ply = 0;
+	char *bs = NULL, *ps = NULL;
+	U8 b[4], pv[4], *dp, left;
+	MovePicker mp;
+	if(!PyArg_ParseTupleAndKeywords( args, kw, "i|izz", kws, &d, &ply, &bs, &ps )) return NULL;
+	if(d<0 || d>=LIB_II_DEPTH || lib_ii_po[d]==NULL) return Py_BuildValue( "i", 0 );
+
+	dp = (U8 *)&lib_ii_mv[(4<<8)*d];
+	left = dp[0] - (U8)((lib_ii_po[d]-(dp+1))>>2);
+	PickerInit( &mp, lib_ii_po[d], left, ply, lib_ord_best( bs, b ), lib_ord_prev( ps, pv ) );
+	while( PickNext( &mp )!=NULL );
+	return Py_BuildValue( "i", left );
+}
+
 PyObject *i_skipmove ( PyObject *self, PyObject *args ) {
-	PyArg_ParseTuple( args,  "i", &depth );
+	LIB_BOARD
+	if(!lib_ii_depth( args, 1 )) return NULL;
 	lib_ii_po[depth]+=4;
 	return Py_BuildValue( "", NULL );
 }
@@ -637,16 +1667,20 @@ int pieces_cnt(int cz) {
 }
 
 PyObject *piecescount ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	return Py_BuildValue( "i", pieces_cnt(0));
 }
 PyObject *whitecount ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	return Py_BuildValue( "i", pieces_cnt(1));
 }
 PyObject *blackcount ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	return Py_BuildValue( "i", pieces_cnt(2));
 }
 
 PyObject *materialdiff ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	
 	int diff = 0;
 	for(U8 j=0;j<14;j++) {
@@ -664,6 +1698,7 @@ PyObject *materialdiff ( PyObject *self, PyObject *args ) {
 // Here is a sample function that can be advanced as chess evaluation or something else.
 //
 PyObject *freaknow ( PyObject *self, PyObject *args ) {
+	LIB_BOARD
 	PyArg_ParseTuple( args,  "" );
 	
 	U64 occupancies = OCC;
@@ -704,27 +1739,78 @@ static PyMethodDef methods[] = {
 	{ "sidetomove", sidetomove, METH_VARARGS, "Side to move 0-white,1-black" },
 	{ "swaptomove", swaptomove, METH_VARARGS, "Swap side to move" },
 	{ "ucimove", ucimove, METH_VARARGS, "Perform an uci move on chess board." },
+	{ "see", see, METH_VARARGS, "Static exchange evaluation of uci move, centipawns." },
+	{ "seemoves", seemoves, METH_VARARGS, "MoveGen with SEE scores. Returns tuple of (uci, see)." },
+	{ "movecache", movecache, METH_VARARGS, "Cache legal move lists of positions for MoveGen users, movecache(mb=64), 0 turns it off. Returns count of entries." },
+	{ "movecache_stats", movecache_stats, METH_VARARGS, "Legal moves cache (hits, misses) since movecache." },
 	{ "undomove", undomove, METH_VARARGS, "Undo the last move. Also iterations." },
 	{ "parsepgn", parsepgn, METH_VARARGS, "Parse PGN and perform moves. Returns uci string." },
+	{ "pgntokens", pgntokens, METH_VARARGS, "Parse PGN with variations and perform main line moves. Returns list of (depth, kind, text, uci)." },
+	{ "parsepgnannots", parsepgnannots, METH_VARARGS, "Parse PGN and perform moves. Returns (uci string, evals, clks) of [%eval] [%clk] comments." },
 	{ "parseucimoves", parseucimoves, METH_VARARGS, "Parse string of ucis for faster performance. Returns count of moves made." },
+	{ "pgn_open", pgn_open, METH_VARARGS, "Open PGN file for reading by games. Returns handle or -1." },
+	{ "pgn_next", pgn_next, METH_VARARGS, "Next game of PGN file, performs moves. Returns (tags, uci string) or None, pgn_next(h,1) adds tokens, pgn_next(h,2) adds evals, clks, 3 both." },
+	{ "pgn_close", pgn_close, METH_VARARGS, "Close PGN file." },
+	{ "pgn_parallel", pgn_parallel, METH_VARARGS, "Parse PGN file by workers (path, workers=0-all CPUs, sink=None|file|callback). Returns list of uci strings or count of games." },
 	{ "ischeck", ischeck, METH_VARARGS, "Is check+ now or not." },
 	{ "ischeckmate", ischeckmate, METH_VARARGS, "Is checkmate# now or not." },
+	{ "game_encode", game_encode, METH_VARARGS, "Uci moves from current position into bytes, one per move, performs moves." },
+	{ "game_decode", game_decode, METH_VARARGS, "Performs moves of bytes from current position. Returns uci string." },
+	{ "games_write", games_write, METH_VARARGS, "Write compact games file of PGN file or list of ucis or (ucis, result). Returns count of games, PGN games with moves not legal are skipped, ValueError in list." },
+	{ "games_open", games_open, METH_VARARGS, "Open compact games file. Returns handle or -1." },
+	{ "games_count", games_count, METH_VARARGS, "Count of games in compact games file." },
+	{ "games_get", games_get, METH_VARARGS, "Game i of compact games file, performs moves. Returns (result, uci string) or None." },
+	{ "games_close", games_close, METH_VARARGS, "Close compact games file." },
+	{ "posdb_build", posdb_build, METH_VARARGS, "Write position database posdb_build(path, keys, values, record_size), keys are ints or bytes of U64. Returns count." },
+	{ "posdb_open", posdb_open, METH_VARARGS, "Open position database, mapped to memory. Returns handle or -1." },
+	{ "posdb_get", posdb_get, METH_VARARGS, "Value of key (or of current position) in database. Returns bytes or None." },
+	{ "posdb_get_many", posdb_get_many, METH_VARARGS, "Values of keys in database. Returns list of bytes or None." },
+	{ "posdb_close", posdb_close, METH_VARARGS, "Close position database." },
+	{ "tbprobe", tbprobe, METH_VARARGS, "Endgame tables win-draw-loss of side to move, -2..2. Returns int or None." },
+	{ "tbdtz", tbdtz, METH_VARARGS, "Endgame tables distance to zeroing move in plies, +win -loss. Returns int or None." },
+	{ "bitbase_build", bitbase_build, METH_VARARGS, "Generate endgame bitbases in memory, as \"KPK KRK KQK\", probed by tbprobe. Returns bytes or 0." },
+	{ "solve_mate", solve_mate, METH_VARARGS, "Moves mating in n moves or less, solve_mate(n, checks_only=0). Returns list of (uci, moves to mate)." },
+	{ "playouts", (PyCFunction)(void(*)(void))playouts, METH_VARARGS|METH_KEYWORDS, "Random playouts: playouts(n, max_plies=200, policy='uniform' or 'captures', workers=0, seed=0). Returns (win, draw, loss, unfinished, plies) of side to move." },
+	{ "mcts_search", (PyCFunction)(void(*)(void))mcts_search, METH_VARARGS|METH_KEYWORDS, "PUCT search: mcts_search(callback, sims, batch=8, cpuct=1.5, max_nodes=200000, workers=1), workers (0-count of cpus) collect leaves of batch, callback(planes, n) -> (policy n*4168, value n), stops when nodes are used up. Returns (value, [(uci, visits, q, prior)])." },
+	{ "ordermoves", (PyCFunction)(void(*)(void))ordermoves, METH_VARARGS|METH_KEYWORDS, "Legal moves in search order: ordermoves(ply=0, best=None, prev=None), best move first, good captures by MVV-LVA and SEE, killers, counter-move of prev, history, losing captures. Returns list of (uci, score)." },
+	{ "order_cutoff", (PyCFunction)(void(*)(void))order_cutoff, METH_VARARGS|METH_KEYWORDS, "Quiet move made beta cut-off: order_cutoff(uci, ply, depth, prev=None), before it is made. Updates killers, counter-moves, history." },
+	{ "order_clear", order_clear, METH_VARARGS, "Clear killers, counter-moves and history of move ordering." },
+	{ "walk", (PyCFunction)(void(*)(void))walk, METH_VARARGS|METH_KEYWORDS, "Depth-first walk of moves: walk(depth, callback=None, moves='all' or 'captures', 'checks', 'tactical', material=0, interior=False). callback(ply, uci, leaf) at leaves (and nodes if interior) with |material| >= material cp, returns False to skip moves of node. Returns (nodes, leaves, visits)." },
+	{ "gamestatus", gamestatus, METH_VARARGS, "Status of game: ongoing, checkmate, stalemate, insufficient, threefold, fifty (may be claimed). Returns (status, halfmove, fullmove, repetitions)." },
+	{ "syzygy_init", syzygy_init, METH_VARARGS, "Syzygy WDL/DTZ files of directories \"dir1:dir2\" (';' on Windows), mapped when probed by tbprobe, tbdtz, tbroot. Returns count of tables." },
+	{ "tbroot", tbroot, METH_VARARGS, "Best move by endgame tables. Returns (uci, wdl) or None." },
 	{ "polyglotkey", polyglotkey, METH_VARARGS, "Get a the polyglot opening book key for position." },
+	{ "book_open", book_open, METH_VARARGS, "Open polyglot .bin book, mapped to memory. Returns handle or -1." },
+	{ "book_moves", book_moves, METH_VARARGS, "Book moves of current position. Returns list of (uci, weight, learn)." },
+	{ "book_pick", book_pick, METH_VARARGS, "Weighted random book move of current position, book_pick(h, r) with r in [0,1). Returns uci or None." },
+	{ "book_close", book_close, METH_VARARGS, "Close polyglot book." },
+	{ "book_build", (PyCFunction)(void(*)(void))book_build, METH_VARARGS|METH_KEYWORDS, "Build polyglot book of PGN file(s): book_build(pgn, out, max_ply=60, min_games=1, mem_mb=256), unfinished games left out. Returns count of entries." },
 	{ "i_movegen", i_movegen, METH_VARARGS, "Iterations. Fast MoveGen at depth." },
 	{ "i_domove", i_domove, METH_VARARGS, "Iterations. Fast DoMove at depth." },
 	{ "i_moveinfo", i_moveinfo, METH_VARARGS, "Iterations. Get move details into variables." },
 	{ "i_moveinfoU64", i_moveinfoU64, METH_VARARGS, "moveinfoU64 into unsigned long long  (fast)" },	
+	{ "i_see", i_see, METH_VARARGS, "Iterations. SEE score of move." },
+	{ "i_order", (PyCFunction)(void(*)(void))i_order, METH_VARARGS|METH_KEYWORDS, "Iterations. Order moves left at depth as ordermoves: i_order(depth, ply=0, best=None, prev=None). Returns count of them." },
 	{ "i_skipmove", i_skipmove, METH_VARARGS, "Iterations. Skip move." },
 	{ "getcastlings", getcastlings, METH_VARARGS, "Get castling variables." },
 	{ "getcastlingsU64", getcastlingsU64, METH_VARARGS, "getcastlings into unsigned long long  (fast)" },
 	{ "getoccupancies", getoccupancies, METH_VARARGS, "Get variables of board occupancies into tuples." },
 	{ "getoccupanciesU64", getoccupanciesU64, METH_VARARGS, "getoccupancies all into unsigned long long  (fast)" },
+	{ "getattacks", getattacks, METH_VARARGS, "Get squares attacked by whites and blacks into tuples." },
+	{ "getattacksU64", getattacksU64, METH_VARARGS, "getattacks into unsigned long long (fast)" },
+	{ "attackers", attackers, METH_VARARGS, "Get white and black pieces attacking square 0..63." },
+	{ "attackersU64", attackersU64, METH_VARARGS, "attackers into unsigned long long (fast)" },
+	{ "attackcounts", attackcounts, METH_VARARGS, "Count of white and black attackers, two tuples of 64." },
 	{ "piecescount", piecescount, METH_VARARGS, "Get count of pieces." },
 	{ "whitecount", whitecount, METH_VARARGS, "Get count of white pieces." },
 	{ "blackcount", blackcount, METH_VARARGS, "Get count of black pieces." },
 	{ "materialdiff", materialdiff, METH_VARARGS, "To indicate material difference, not 0." },
 	{ "uniq", uniq, METH_VARARGS, "Get 70 bytes unique string of position." },
 	{ "setasuniq", setasuniq, METH_VARARGS, "Set position as unig string." },
+	{ "posbin", posbin, METH_VARARGS, "Get 24 bytes binary code of position." },
+	{ "setposbin", setposbin, METH_VARARGS, "Set position as binary code." },
+	{ "posbins", posbins, METH_VARARGS, "Binary codes of current position and after each of uci moves, performs moves. Returns bytes." },
+	{ "posbin_fens", posbin_fens, METH_VARARGS, "Decode bytes of binary positions. Returns list of FEN." },
 	{ "seemslegitpos", seemslegitpos, METH_VARARGS, "Verify chess position normality" },
 	{ "freaknow", freaknow, METH_VARARGS, "C route sample returns occupancy of white king." },
 	{ NULL, NULL, 0, NULL }
@@ -739,8 +1825,32 @@ static struct PyModuleDef chelpy = {
 };
 
 //------------------------------------------
+// slider tables file, CHELPY_TABLES="" to calculate on every import,
+// default in user's cache directory
+char *lib_tables_path( char *buf ) {
+	char *e = getenv( "CHELPY_TABLES" ), *c;
+	if(e!=NULL) return e;
+#ifndef _WIN32
+	c = getenv( "XDG_CACHE_HOME" );
+	if(c!=NULL && c[0]!=0 && strlen(c)<900) sprintf( buf, "%s", c );
+	else {
+		c = getenv( "HOME" );
+		if(c==NULL || c[0]==0 || strlen(c)>900) return NULL;
+		sprintf( buf, "%s/.cache", c );
+	}
+	mkdir( buf, 0700 );
+	strcat( buf, "/chelpy" );
+	mkdir( buf, 0700 );
+	strcat( buf, "/tables.bin" );
+	return buf;
+#else
+	return NULL;
+#endif
+}
+
 PyMODINIT_FUNC PyInit_chelpy() {
-	Init_u64_chess();
+	char buf[1024];
+	if(!Init_u64_chess_file( lib_tables_path( buf ) )) return PyErr_NoMemory();
 
 	printf("Chess library ready.\n");
 	return PyModule_Create( &chelpy );
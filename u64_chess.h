@@ -43,6 +43,17 @@ Compilers ok: gcc, clang, MS Visual Studio C++
 #ifndef _INC_u64_CHESS
 #define _INC_u64_CHESS
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
 #define CONST static const
 
 typedef unsigned long long U64;
@@ -51,14 +62,29 @@ typedef unsigned short U16;
 typedef unsigned char U8;
 
 extern void Init_u64_chess();               /* Init, should call once on start */
+extern U8 Init_u64_chess_file( char *path );  /* Init, slider tables shared in file, ret.1=ok */
 extern void SetStartPos();                  /* Clear and set chess beginning position */
 extern void PutPiece( char *pieceAt );      /* Can put pieces directly on board "Pe2" */
 extern void SetByFEN( char *pos );          /* UCI interface, set FEN position, slow */
 extern void sGetFEN( char *buffer );        /* Get current FEN string into buffer */
-extern U8 uciMove( char *mstr );            /* UCI move as "e2e4", ret.1=ok,0=error, MoveGen,slow */
+extern U8 uciMove( char *mstr );            /* UCI move as "e2e4", ret.1=ok,0=error, no MoveGen */
 extern void MoveGen( U8 *mvlist );          /* Generate list of Legal moves */
+extern long long MoveGenCache( long long bytes );  /* Cache MoveGen lists, 0=off, ret.entries */
 extern U8 IsCheckNow();                     /* Returns: 1=check+, 0=no */
 extern U8 IsCheckMateNow();                 /* Returns: 1=checkmate#, 0=no */
+extern U8 Repetitions();                    /* Count of current position in game, 1=new */
+extern U8 InsufficientMaterial();           /* Returns: 1=nobody can mate, 0=no */
+extern U8 GameStatus();                     /* GAME_ON, GAME_CHECKMATE,... */
+
+// attack maps
+extern U64 AttacksBySide( U8 side );        /* All squares attacked by 0-white,1-black */
+extern U64 AttackersTo( U8 sq, U64 occ );   /* Pieces of both sides attacking square */
+extern void AttackCounts( U8 *wcnt, U8 *bcnt );  /* Count of attackers per square [64] */
+
+// compact position
+extern int PosEncode( U8 *b );              /* Position into POS_BYTES bytes */
+extern U8 PosDecode( const U8 *b );         /* Sets position of bytes, ret.1=ok,0=error */
+extern U64 BoardHash();                     /* Fast 64-bit hash of position, not polyglot */
 
 // output to string
 extern void sBoard( char *buffer );                  /* Current Board to string */
@@ -72,6 +98,8 @@ U64 BK, BQ, BR, BB, BN, BP; // Black pieces
 U64 ENPSQ;                  // EnPassant square
 U64 CASTLES;                // Castling bits of kings, rooks
 U8  ToMove;                 // 0-white/1-black to move
+U16 HalfMoves;              // plies since capture or pawn move
+U16 FullMoves;              // number of move, from 1
 
 // IMPORTANT!!!
 // set to undobuffer on each position reset
@@ -121,13 +149,18 @@ U8 mg_sq, mg_sqTo, mg_sqA;      // squares
 U8 mg_ty, mg_tc;                // piece type: which moves, which captured
 
 U8 mg_1mv = 0;              // internal to verify checkmates (1-exit loops on 1st found)
+U8 mg_noflags = 0;          // 1-no check+, checkmate# flags (playouts, faster)
 U8 mg_ck_list[4<<8];         // when checking checkmates
 
 U8 mg_pI, mg_pN, *mg_pm;    // checkmate flag checking
 U8 *mg_c2, *mg_p2;          // saves pointer and counter
 
-U64 undobuffer[14<<10];       //114688 bytes,
-                            // contains variables for fast undo
+#define UNDO_REC 15         // U64 per move: boards, castles, en-passant, clocks
+#define UNDO_PLIES 1024
+
+U64 undobuffer[UNDO_REC*UNDO_PLIES];    //122880 bytes,
+                            // contains variables for fast undo,
+                            // positions of game for repetitions
 
 //-------------------------------------------------------
 // uciMove variables
@@ -135,6 +168,7 @@ U64 undobuffer[14<<10];       //114688 bytes,
 //
 U8 mg_uci_list[1024];       // uci move list
 U8 *mg_uci_po;              // uci move pointer to move
+U8 mg_uci_mv[4];            // last move of uciMove, without check+ flags
 
 //--------------------
 
@@ -247,8 +281,9 @@ CONST U64 PawnMagicsBlack[] = {
 U64 BishopMask[64];
 U64 RookMask[64];
 
-U64 BishopLegalsTable[64][1<<16];
-U64 RookLegalsTable[64][1<<16];
+// 64MB, mapped of tables file read-only or allocated, see Init_u64_chess_file
+U64 (*BishopLegalsTable)[1<<16];
+U64 (*RookLegalsTable)[1<<16];
 
 U64 KnightLegals[64];
 U64 KingLegals[64];
@@ -397,6 +432,8 @@ void Permutate(U8 pawncase) {
         }
 }
 
+U8 tbl_sliders = 1;     // 0-slider tables are mapped, only masks to prepare
+
 void prepare_tables() {
 
     for(SqI=0;SqI<64;SqI++) {
@@ -409,7 +446,7 @@ void prepare_tables() {
             if(b_r) BishopMask[SqI]= Bo1;
             else RookMask[SqI]= Bo1;
             legalck=1;
-            Permutate(0);
+            if(tbl_sliders) Permutate(0);
         }
 
         for(b_w=0; b_w<2; b_w++) {
@@ -469,6 +506,254 @@ void isCheckedKing() {
         }
 }
 
+/*
+    Attack maps, all at once, not one square by sqAttackedBy...
+    Do not touch MoveGen variables, so can be called anytime.
+*/
+
+#define FILE_A 0x0101010101010101LL
+#define FILE_H 0x8080808080808080LL
+
+// squares attacked by pawns (shifts, not tables, pawns on 7th rank too)
+#define WhitePawnsAttacks(p) ((((p)&~FILE_A)<<7)|(((p)&~FILE_H)<<9))
+#define BlackPawnsAttacks(p) ((((p)&~FILE_H)>>7)|(((p)&~FILE_A)>>9))
+
+/*
+    Full attack bitboard of side (0-white, 1-black)
+*/
+U64 AttacksBySide( U8 side ) {
+
+    U64 occ = WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP;
+    U64 a, o;
+    U8 sq;
+
+    if(side) {
+        a = KingLegals[trail0(BK)] | BlackPawnsAttacks(BP);
+        for(o=BN; o; o&=o-1) a |= KnightLegals[trail0(o)];
+        for(o=BB|BQ; o; o&=o-1) { sq=trail0(o); a |= getBishopMove(sq,occ); }
+        for(o=BR|BQ; o; o&=o-1) { sq=trail0(o); a |= getRookMove(sq,occ); }
+        }
+    else {
+        a = KingLegals[trail0(WK)] | WhitePawnsAttacks(WP);
+        for(o=WN; o; o&=o-1) a |= KnightLegals[trail0(o)];
+        for(o=WB|WQ; o; o&=o-1) { sq=trail0(o); a |= getBishopMove(sq,occ); }
+        for(o=WR|WQ; o; o&=o-1) { sq=trail0(o); a |= getRookMove(sq,occ); }
+        }
+    return a;
+}
+
+/*
+    All pieces (both sides) attacking square sq with given occupancy.
+    AND with WOCC or BOCC to get one side.
+*/
+U64 AttackersTo( U8 sq, U64 occ ) {
+
+    return (KingLegals[sq]&(WK|BK)) |
+        (KnightLegals[sq]&(WN|BN)) |
+        (getRookMove(sq,occ)&(WR|WQ|BR|BQ)) |
+        (getBishopMove(sq,occ)&(WB|WQ|BB|BQ)) |
+        (PawnWhiteAtck[sq]&WP) | (PawnBlackAtck[sq]&BP);
+}
+
+/*
+    Squares strictly between a and b, if on the same line, or 0
+*/
+U64 BetweenSq( U8 a, U8 b ) {
+
+    U64 ba = (1LL<<a), bb = (1LL<<b);
+    if(getRookMove(a,0LL) & bb) return getRookMove(a,bb) & getRookMove(b,ba);
+    if(getBishopMove(a,0LL) & bb) return getBishopMove(a,bb) & getBishopMove(b,ba);
+    return 0LL;
+}
+
+/*
+    Pieces (any side) standing alone between square sq and a slider
+    of rq (rooks,queens) or bq (bishops,queens) - pins or discovered checks.
+*/
+U64 SliderBlockers( U8 sq, U64 rq, U64 bq, U64 occ ) {
+
+    U64 o, bt, blk = 0LL;
+    for(o = (getRookMove(sq,0LL) & rq)|(getBishopMove(sq,0LL) & bq); o; o&=o-1) {
+        bt = BetweenSq( sq, trail0(o) ) & occ;
+        if(bt && !(bt&(bt-1))) blk |= bt;
+        }
+    return blk;
+}
+
+/*
+    Counts attackers per square for each side.
+    For a piece on square: own side count = defenders, other side = attackers.
+*/
+void cntAttacks( U8 *cnt, U64 a ) {
+    while(a) {
+        cnt[trail0(a)]++;
+        a &= a-1;
+    }
+}
+
+void AttackCounts( U8 *wcnt, U8 *bcnt ) {
+
+    U64 occ = WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP;
+    U64 o;
+    U8 sq;
+
+    for(sq=0; sq<64; sq++) wcnt[sq]=bcnt[sq]=0;
+
+    cntAttacks( wcnt, KingLegals[trail0(WK)] );
+    cntAttacks( wcnt, ((WP&~FILE_A)<<7) );
+    cntAttacks( wcnt, ((WP&~FILE_H)<<9) );
+    for(o=WN; o; o&=o-1) cntAttacks( wcnt, KnightLegals[trail0(o)] );
+    for(o=WB|WQ; o; o&=o-1) { sq=trail0(o); cntAttacks( wcnt, getBishopMove(sq,occ) ); }
+    for(o=WR|WQ; o; o&=o-1) { sq=trail0(o); cntAttacks( wcnt, getRookMove(sq,occ) ); }
+
+    cntAttacks( bcnt, KingLegals[trail0(BK)] );
+    cntAttacks( bcnt, ((BP&~FILE_H)>>7) );
+    cntAttacks( bcnt, ((BP&~FILE_A)>>9) );
+    for(o=BN; o; o&=o-1) cntAttacks( bcnt, KnightLegals[trail0(o)] );
+    for(o=BB|BQ; o; o&=o-1) { sq=trail0(o); cntAttacks( bcnt, getBishopMove(sq,occ) ); }
+    for(o=BR|BQ; o; o&=o-1) { sq=trail0(o); cntAttacks( bcnt, getRookMove(sq,occ) ); }
+}
+
+/*
+    Which piece is on square, returns index of PIECES[], or 6 if empty
+*/
+U8 PieceAt( U8 sq ) {
+    U64 b = (1LL<<sq);
+    for(U8 j=0;j<14;j++) {
+        if(j==6) j=8;
+        if( *(PIECES[j]) & b ) return j;
+        }
+    return 6;
+}
+
+/*
+    Squares a1..h8 and promotion letter (or end) of uci string
+*/
+U8 uciValid( char *mstr ) {
+    char pr;
+    if(mstr[0]<'a' || mstr[0]>'h' || mstr[1]<'1' || mstr[1]>'8' ||
+        mstr[2]<'a' || mstr[2]>'h' || mstr[3]<'1' || mstr[3]>'8') return 0;
+    pr = mstr[4];
+    return (pr==0 || strchr( "qrbnQRBN", pr )!=NULL);
+}
+
+/*
+    Builds 4-byte move record from uci "e2e4", "b7a8q" as MoveGen does,
+    but without any legality verification and without check+ flags.
+    Returns 0 if not a uci string or there is no piece of side to move
+    at from-square.
+*/
+U8 uciToMv( char *mstr, U8 *mv ) {
+
+    U8 sq1, sq2, ty, tc, fl = 0;
+    char pr;
+
+    if(!uciValid( mstr )) return 0;
+    sq1 = (((mstr[1]-'1')<<3)|(mstr[0]-'a'));
+    sq2 = (((mstr[3]-'1')<<3)|(mstr[2]-'a'));
+    ty = PieceAt(sq1);
+    pr = mstr[4];
+
+    if( ty==6 || (ty>>3)!=ToMove ) return 0;
+    tc = PieceAt(sq2);
+    if(tc!=6) {
+        if((tc>>3)==ToMove) return 0;
+        fl = 1;
+        }
+    if((ty&7)==4) {
+        if(ENPSQ==(1LL<<sq2) && (sq1&7)!=(sq2&7)) {
+            fl = 1|16;
+            tc = (ToMove ? 4 : 12);
+            }
+        if(sq2<8 || sq2>55) {
+            fl |= 2;
+            if(pr=='r'||pr=='R') fl |= 4;
+            else if(pr=='b'||pr=='B') fl |= 8;
+            else if(pr=='n'||pr=='N') fl |= 12;
+            }
+        }
+    if((ty&7)==5 && (sq1-sq2==2 || sq2-sq1==2)) fl = 32;
+    mv[0] = ty|((fl&1) ? (tc<<4) : 0);
+    mv[1] = sq1;
+    mv[2] = sq2;
+    mv[3] = fl;
+    return 1;
+}
+
+/*
+    Static exchange evaluation.
+    Swap-off on the to-square with x-rays through the magic lookups.
+    mv is a 4-byte move as in MoveGen list.
+    Returns material gain (centipawns) for the side making the move.
+*/
+
+CONST int SeeValues[] = { 900, 500, 320, 320, 100, 20000, 0, 0 };
+
+// order of least valuable attackers: P,N,B,R,Q,K
+CONST U8 see_order[] = { 4, 3, 2, 1, 0, 5 };
+
+int SEE( U8 *mv ) {
+
+    int gain[32], d = 0;
+    U8 ty = mv[0]&15, sqFr = mv[1], sqTo = mv[2], fl = mv[3];
+    U8 side = (ty>>3), i, t;
+    U64 occ = WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP;
+    U64 diag = WB|WQ|BB|BQ, line = WR|WQ|BR|BQ;
+    U64 atck, o, b;
+    int aval = SeeValues[ty&7];
+
+    if(fl&32) return 0;     // castling
+
+    gain[0] = 0;
+    if(fl&1) {
+        gain[0] = SeeValues[(mv[0]>>4)&7];
+        if(fl&16) occ ^= (side ? (1LL<<(sqTo+8)) : (1LL<<(sqTo-8)));
+        }
+    if(fl&2) {              // promoted piece stands on square
+        aval = SeeValues[(fl>>2)&3];
+        gain[0] += aval - SeeValues[4];
+        }
+
+    occ ^= (1LL<<sqFr);
+    atck = AttackersTo( sqTo, occ ) & occ;
+
+    for(;;) {
+        d++;
+        side ^= 1;
+        gain[d] = aval - gain[d-1];
+        if( ((-gain[d-1]) < gain[d] ? gain[d] : (-gain[d-1])) < 0 ) break;
+
+        // least valuable attacker of side
+        b = 0;
+        for(i=0; i<6; i++) {
+            t = see_order[i] + (side<<3);
+            o = atck & (*PIECES[t]);
+            if(o) { b = o & (-o); break; }
+            }
+        if(!b) break;
+
+        occ ^= b;
+        aval = SeeValues[t&7];
+                // discovered x-rays behind
+        atck |= (getBishopMove(sqTo,occ) & diag) | (getRookMove(sqTo,occ) & line);
+        atck &= occ;
+        }
+
+    while(--d) {
+        gain[d-1] = -((-gain[d-1]) > gain[d] ? (-gain[d-1]) : gain[d]);
+        }
+    return gain[0];
+}
+
+/*
+    SEE scores for each move of list after MoveGen
+*/
+void SeeList( U8 *mvlist, int *scores ) {
+    U8 *p = mvlist;
+    U8 i, n = *(p++);
+    for(i=0; i<n; i++, p+=4) scores[i] = SEE(p);
+}
+
 /*
     Make a chess move on board
 */
@@ -480,6 +765,7 @@ void DoMove( U8 *mv ) {
     *(undo_p++)=BQ; *(undo_p++)=BR; *(undo_p++)=BB;
     *(undo_p++)=BN; *(undo_p++)=BP; *(undo_p++)=BK;
     *(undo_p++)=CASTLES; *(undo_p++)=ENPSQ;
+    *(undo_p++)=(((U64)HalfMoves)<<16)|FullMoves;
 
     mg_ty = *(mv++);
     mg_sq = *(mv++);
@@ -530,7 +816,11 @@ void DoMove( U8 *mv ) {
         else {
             if(mg_sq<16 && mg_sqTo>23) ENPSQ = (1LL<<(mg_sq+8));
             }
+        HalfMoves = 0;
         }
+    else if(mg_fl&1) HalfMoves = 0;
+    else HalfMoves++;
+    if(ToMove) FullMoves++;
     ToMove^=1;
 }
 
@@ -540,7 +830,9 @@ void DoMove( U8 *mv ) {
 
 void UnDoMove() {
 
+    U64 clk = *(--undo_p);
     ToMove^=1;
+    HalfMoves = (U16)(clk>>16); FullMoves = (U16)clk;
     ENPSQ = *(--undo_p); CASTLES = *(--undo_p);
     BK = *(--undo_p); BP = *(--undo_p); BN = *(--undo_p);
     BB = *(--undo_p); BR = *(--undo_p); BQ = *(--undo_p);
@@ -548,6 +840,116 @@ void UnDoMove() {
     WB = *(--undo_p); WR = *(--undo_p); WQ = *(--undo_p);
 }
 
+/*
+    Is king of side which just moved (not ToMove) attacked?
+    To verify a move after DoMove.
+*/
+U8 MoverInCheck() {
+    U64 wocc = WK|WQ|WR|WB|WN|WP, bocc = BK|BQ|BR|BB|BN|BP;
+    if(ToMove) return ((AttackersTo( trail0(WK), wocc|bocc ) & bocc) ? 1 : 0);
+    return ((AttackersTo( trail0(BK), wocc|bocc ) & wocc) ? 1 : 0);
+}
+
+/*
+    Can side to move castle with king to square sqTo (g1,c1,g8,c8)?
+    Rights, empty squares and not attacked king path.
+*/
+U8 CanCastle( U8 sqTo ) {
+
+    U64 occ = WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP;
+    U64 opp = (ToMove ? WK|WQ|WR|WB|WN|WP : BK|BQ|BR|BB|BN|BP);
+    U8 k = (ToMove ? 60 : 4), sq;
+    U64 cs, em;
+
+    if(sqTo==k+2) {
+        cs = (ToMove ? castle_E8H8 : castle_E1H1);
+        em = (ToMove ? sqF8G8 : sqF1G1);
+        }
+    else if(sqTo==k-2) {
+        cs = (ToMove ? castle_E8C8 : castle_E1C1);
+        em = (ToMove ? sqD8C8B8 : sqD1C1B1);
+        }
+    else return 0;
+
+    if(((CASTLES & cs)!=cs) || (occ & em)) return 0;
+    for(sq = (k<sqTo ? k : sqTo); sq <= (k<sqTo ? sqTo : k); sq++) {
+        if(AttackersTo( sq, occ ) & opp) return 0;
+        }
+    return 1;
+}
+
+/*
+    Can the piece of move record (uciToMv) go there by its rules?
+    King safety is not verified here, see MoverInCheck.
+*/
+U8 IsPseudoLegal( U8 *mv ) {
+
+    U8 ty = mv[0]&7, sq1 = mv[1], sq2 = mv[2], fl = mv[3];
+    U64 occ = WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP;
+    U64 fr = (1LL<<sq1), to = (1LL<<sq2), b;
+
+    switch(ty) {
+        case 0: b = getRookMove(sq1,occ) | getBishopMove(sq1,occ); break;
+        case 1: b = getRookMove(sq1,occ); break;
+        case 2: b = getBishopMove(sq1,occ); break;
+        case 3: b = KnightLegals[sq1]; break;
+        case 5:
+            if(fl&32) return CanCastle( sq2 );
+            b = KingLegals[sq1];
+            break;
+        default:
+            if(fl&1) {
+                b = (ToMove ? PawnBlackAtck[sq2] : PawnWhiteAtck[sq2]);
+                return ((b & fr) ? 1 : 0);
+                }
+            if(occ & to) return 0;
+            if(ToMove) {
+                if(sq2+8==sq1) return 1;
+                return ((sq1>47 && sq2+16==sq1 && !(occ & (to<<8))) ? 1 : 0);
+                }
+            if(sq1+8==sq2) return 1;
+            return ((sq1<16 && sq1+16==sq2 && !(occ & (to>>8))) ? 1 : 0);
+        }
+    return ((b & to) ? 1 : 0);
+}
+
+/*
+    Prepares squares to give check+ from, once per MoveGen:
+        mg_ckSq[piece type] - direct checks to opposite king
+        mg_ckDc - our pieces in line between king and our slider,
+                moving away may discover check+
+*/
+
+U64 mg_ckSq[8], mg_ckDc, mg_ckRQ, mg_ckBQ;
+U8 mg_ckK;
+
+void prepCheckSquares() {
+
+    U64 r, b, own;
+
+    if(ToMove) {
+        mg_ckK = trail0(WK);
+        mg_ckSq[4] = PawnBlackAtck[mg_ckK];
+        mg_ckRQ = BR|BQ; mg_ckBQ = BB|BQ;
+        own = BOCC;
+        }
+    else {
+        mg_ckK = trail0(BK);
+        mg_ckSq[4] = PawnWhiteAtck[mg_ckK];
+        mg_ckRQ = WR|WQ; mg_ckBQ = WB|WQ;
+        own = WOCC;
+        }
+    r = getRookMove(mg_ckK,OCC);
+    b = getBishopMove(mg_ckK,OCC);
+    mg_ckSq[0] = r|b;
+    mg_ckSq[1] = r;
+    mg_ckSq[2] = b;
+    mg_ckSq[3] = KnightLegals[mg_ckK];
+    mg_ckSq[5] = 0LL;
+
+    mg_ckDc = SliderBlockers( mg_ckK, mg_ckRQ, mg_ckBQ, OCC ) & own;
+}
+
 /*
     Sets Check+ flags
 */
@@ -556,6 +958,19 @@ void getFlags() {
 
     if(mg_1mv) return;
 
+    if(!((*mg_po)&(2|16|32))) {
+            // usual move, use check squares prepared in MoveGen
+        if( mg_ckSq[mg_ty&7] & mg_to ) {
+            *(mg_po)|=64;
+            }
+        else if( mg_ckDc & mg_fr ) {
+                // may be discovered, OCC is after the move
+            if( (getRookMove(mg_ckK,OCC) & mg_ckRQ) ||
+                (getBishopMove(mg_ckK,OCC) & mg_ckBQ) ) *(mg_po)|=64;
+            }
+        return;
+    }
+            // promotions, en-passant, castlings
     if(ToMove) {
         mg_sqA = trail0(WK);
         sqAttackedByBlacks();       // is opposite king checked+?
@@ -572,6 +987,84 @@ void getFlags() {
     }
 }
 
+/*
+    Side to move is in check+, is there any legal move?
+    King escapes, then captures of single checker, then interpositions.
+    Pinned pieces can not help at all. Faster than MoveGen.
+*/
+
+U8 HasEvasion() {
+
+    U64 wocc = WK|WQ|WR|WB|WN|WP, bocc = BK|BQ|BR|BB|BN|BP;
+    U64 occ = wocc|bocc;
+    U64 own, opp, kb, o, chk, target, pinned, mv, p, q, sv;
+    U8 ksq, sq, csq;
+
+    if(ToMove) { kb=BK; own=bocc; opp=wocc; }
+    else { kb=WK; own=wocc; opp=bocc; }
+    ksq = trail0(kb);
+
+        // king escapes, x-rays through king
+    for(o = KingLegals[ksq] & (~own); o; o&=o-1) {
+        if(!(AttackersTo( trail0(o), occ^kb ) & opp)) return 1;
+        }
+
+    chk = AttackersTo( ksq, occ ) & opp;
+    if(chk & (chk-1)) return 0;     // double check+, only king could
+
+    csq = trail0(chk);
+    target = chk | BetweenSq( ksq, csq );
+
+    if(ToMove) pinned = SliderBlockers( ksq, WR|WQ, WB|WQ, occ ) & own;
+    else pinned = SliderBlockers( ksq, BR|BQ, BB|BQ, occ ) & own;
+
+    if(ToMove) {
+        for(o = BN & ~pinned; o; o&=o-1) if(KnightLegals[trail0(o)] & target) return 1;
+        for(o = (BB|BQ) & ~pinned; o; o&=o-1) if(getBishopMove(trail0(o),occ) & target) return 1;
+        for(o = (BR|BQ) & ~pinned; o; o&=o-1) if(getRookMove(trail0(o),occ) & target) return 1;
+        for(o = BP & ~pinned; o; o&=o-1) {
+            sq = trail0(o);
+            mv = getBlackPawnMove(sq,occ) & (~own) & target;
+            if(mv) return 1;
+            }
+        }
+    else {
+        for(o = WN & ~pinned; o; o&=o-1) if(KnightLegals[trail0(o)] & target) return 1;
+        for(o = (WB|WQ) & ~pinned; o; o&=o-1) if(getBishopMove(trail0(o),occ) & target) return 1;
+        for(o = (WR|WQ) & ~pinned; o; o&=o-1) if(getRookMove(trail0(o),occ) & target) return 1;
+        for(o = WP & ~pinned; o; o&=o-1) {
+            sq = trail0(o);
+            mv = getWhitePawnMove(sq,occ) & (~own) & target;
+            if(mv) return 1;
+            }
+        }
+
+        // en-passant, try it on board, rare case
+    if(ENPSQ) {
+        if(ToMove) {
+            p = ENPSQ<<8;   // captured white pawn
+            o = WhitePawnsAttacks(ENPSQ) & BP;
+            }
+        else {
+            p = ENPSQ>>8;   // captured black pawn
+            o = BlackPawnsAttacks(ENPSQ) & WP;
+            }
+        for(; o; o&=o-1) {
+            q = o & (-o);
+            sv = (occ ^ q ^ p) | ENPSQ;
+            if(ToMove) {
+                if(!( ((getRookMove(ksq,sv) & (WR|WQ)) | (getBishopMove(ksq,sv) & (WB|WQ)) |
+                    (KnightLegals[ksq] & WN) | (PawnWhiteAtck[ksq] & WP & ~p)) )) return 1;
+                }
+            else {
+                if(!( ((getRookMove(ksq,sv) & (BR|BQ)) | (getBishopMove(ksq,sv) & (BB|BQ)) |
+                    (KnightLegals[ksq] & BN) | (PawnBlackAtck[ksq] & BP & ~p)) )) return 1;
+                }
+            }
+        }
+    return 0;
+}
+
 /*
     Verifies checkmate cases, if check+ flag is set.
 */
@@ -586,18 +1079,10 @@ void getCheckMateFlags( U8 *mvlist ) {
      if( (*(mg_pm+3)) & 64 ) {  // if check+
 
         DoMove(mg_pm);
-        mg_1mv = 1;
-        mg_p2 = mg_po;
-        mg_c2 = mg_cnt;
 
-        MoveGen(mg_ck_list);
-
-        if(!( *mg_cnt)) {
+        if(!HasEvasion()) {
             *(mg_pm+3) |= 128;      // add checkmate flag, if could not escape check
         }
-        mg_1mv = 0;
-        mg_po = mg_p2;
-        mg_cnt = mg_c2;
         UnDoMove();
 
         }
@@ -634,12 +1119,13 @@ void addMove( U64 mo ) {
 
         if(ToMove) {               // black
             mg_sqA = trail0(BK);
-            if(EWOCC & mg_to) {
+            if((mg_ty==12 ? EWOCC : WOCC) & mg_to) {    // en-passant square by pawn only
                 mg_fC = 1;
                 mg_sQ=WQ; mg_sR=WR; mg_sB=WB; mg_sN=WN; mg_sP=WP;   // save
                 WQ &= mg_nt; WR &= mg_nt; WB &= mg_nt; WN &= mg_nt; WP &= mg_nt;
                 if((mg_to==ENPSQ) && (mg_ty==12)) {
                     WP &= ~(ENPSQ<<8);
+                    OCC &= ~(ENPSQ<<8);
                     mg_fE = 16;
                     }
                 mg_tc=( WR!=mg_sR?1: (WB!=mg_sB?2 :(WN!=mg_sN?3 :(WP!=mg_sP?4: 0))));
@@ -658,7 +1144,7 @@ void addMove( U64 mo ) {
                 *(mg_po)=(mg_fC|mg_fP|mg_fE);
                 (*mg_cnt)++;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                 mg_po++;
 
@@ -673,7 +1159,7 @@ void addMove( U64 mo ) {
                     *(mg_po)=(mg_fC|(mg_fP|4)|mg_fE);
                     (*mg_cnt)++;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                     mg_po++;
                     BR=mg_ss;
@@ -686,7 +1172,7 @@ void addMove( U64 mo ) {
                     *(mg_po)=(mg_fC|(mg_fP|8)|mg_fE);
                     (*mg_cnt)++;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                     mg_po++;
                     BB=mg_ss;
@@ -699,7 +1185,7 @@ void addMove( U64 mo ) {
                     *(mg_po)=(mg_fC|(mg_fP|12)|mg_fE);
                     (*mg_cnt)++;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                     mg_po++;
                     BN=mg_ss;
@@ -713,12 +1199,13 @@ void addMove( U64 mo ) {
             }
         else {                      // white
             mg_sqA = trail0(WK);
-            if(EBOCC & mg_to) {
+            if((mg_ty==4 ? EBOCC : BOCC) & mg_to) {     // en-passant square by pawn only
                 mg_fC = 1;
                 mg_sQ=BQ; mg_sR=BR; mg_sB=BB; mg_sN=BN; mg_sP=BP;   // save
                 BQ &= mg_nt; BR &= mg_nt; BB &= mg_nt; BN &= mg_nt; BP &= mg_nt;
                 if((mg_to==ENPSQ) && (mg_ty==4)) {
                     BP &= ~(ENPSQ>>8);
+                    OCC &= ~(ENPSQ>>8);
                     mg_fE = 16;
                     }
                 mg_tc=( BR!=mg_sR?9: (BB!=mg_sB?10 :(BN!=mg_sN?11 :(BP!=mg_sP?12: 8))));
@@ -738,7 +1225,7 @@ void addMove( U64 mo ) {
                 (*mg_cnt)++;
 
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                 mg_po++;
 
@@ -753,7 +1240,7 @@ void addMove( U64 mo ) {
                     *(mg_po)=(mg_fC|(mg_fP|4)|mg_fE);
                     (*mg_cnt)++;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                     mg_po++;
                     WR=mg_ss;
@@ -766,7 +1253,7 @@ void addMove( U64 mo ) {
                     *(mg_po)=(mg_fC|(mg_fP|8)|mg_fE);
                     (*mg_cnt)++;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                     mg_po++;
                     WB=mg_ss;
@@ -779,7 +1266,7 @@ void addMove( U64 mo ) {
                     *(mg_po)=(mg_fC|(mg_fP|12)|mg_fE);
                     (*mg_cnt)++;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
                     mg_po++;
                     WN=mg_ss;
@@ -821,7 +1308,7 @@ void addCastleMove() {
     *(mg_po++)  =mg_sqA;
     *(mg_po) = 32;
                 #ifdef mg_CHECK_FLAG
-                    if(!mg_1mv) getFlags();
+                    if(!(mg_1mv|mg_noflags)) getFlags();
                 #endif
     (*mg_cnt)++;
     mg_po++;
@@ -835,12 +1322,110 @@ void addCastleMove() {
         }
 }
 
+/*
+    Cache of legal move lists, off until MoveGenCache sizes it.
+    Sets of MGC_WAYS entries by BoardHash, the whole position is
+    compared, so there are no false hits. Second chance (clock)
+    replacement in a set. Not for mg_1mv or mg_noflags lists.
+*/
+
+#define MGC_MOVES 64                // longer lists are not cached
+#define MGC_WAYS 4
+
+typedef struct {
+    U64 b[14];                      // WQ..BK, CASTLES, ENPSQ as undo record
+    U8 tomove, ref;                 // ref: hit since clock hand passed
+    U8 list[1+(MGC_MOVES<<2)];
+} MgcEntry;
+
+MgcEntry *mgc = NULL;
+U8 *mgc_hand;                       // clock hand of each set
+U64 mgc_mask;                       // sets-1
+long long mgc_hits = 0, mgc_misses = 0;
+
+/*
+    Allocates cache of about bytes, 0 frees it. Clears counters.
+    Returns count of entries.
+*/
+long long MoveGenCache( long long bytes ) {
+
+    U64 sets = 1;
+
+    free( mgc ); free( mgc_hand );
+    mgc = NULL; mgc_hand = NULL;
+    mgc_hits = mgc_misses = 0;
+    if(bytes < (long long)(MGC_WAYS*sizeof(MgcEntry))) return 0;
+    while((sets<<1)*MGC_WAYS*sizeof(MgcEntry) <= (U64)bytes) sets <<= 1;
+    mgc = (MgcEntry *)calloc( sets*MGC_WAYS, sizeof(MgcEntry) );
+    mgc_hand = (U8 *)calloc( sets, 1 );
+    if(mgc==NULL || mgc_hand==NULL) {
+        free( mgc ); free( mgc_hand );
+        mgc = NULL; mgc_hand = NULL;
+        return 0;
+        }
+    mgc_mask = sets-1;
+    return (long long)(sets*MGC_WAYS);
+}
+
+U8 mgcSame( MgcEntry *e ) {
+    U8 j, k;
+    if(e->tomove!=ToMove || e->b[12]!=CASTLES || e->b[13]!=ENPSQ) return 0;
+    for(j=k=0; j<14; j++) {
+        if(j==6) j = 8;
+        if(e->b[k++]!=*PIECES[j]) return 0;
+        }
+    return 1;
+}
+
+// copies list of position, if cached, set of position to *set
+U8 mgcGet( U8 *list, MgcEntry **set ) {
+
+    MgcEntry *e = *set = mgc + (BoardHash() & mgc_mask)*MGC_WAYS;
+    U8 i;
+
+    for(i=0; i<MGC_WAYS; i++, e++) {
+        if(mgcSame( e )) {
+            memcpy( list, e->list, 1+(e->list[0]<<2) );
+            e->ref = 1;
+            mgc_hits++;
+            return 1;
+            }
+        }
+    mgc_misses++;
+    return 0;
+}
+
+void mgcPut( U8 *list, MgcEntry *set ) {
+
+    U64 h = (U64)(set-mgc)/MGC_WAYS;
+    U8 j, k, *hand = &mgc_hand[h];
+    MgcEntry *e;
+
+    if(list[0]>MGC_MOVES) return;
+    for(;;) {
+        e = set + *hand;
+        *hand = (*hand+1)%MGC_WAYS;
+        if(!e->ref) break;
+        e->ref = 0;
+        }
+    for(j=k=0; j<14; j++) {
+        if(j==6) j = 8;
+        e->b[k++] = *PIECES[j];
+        }
+    e->b[12] = CASTLES;
+    e->b[13] = ENPSQ;
+    e->tomove = ToMove;
+    memcpy( e->list, list, 1+(list[0]<<2) );
+}
+
 /*
     Cenerates the list of legal chess moves on current board
 */
 
 void MoveGen( U8 *listStoreTo ) {
 
+    MgcEntry *mgc_set = NULL;
+
     WOCC = WK|WQ|WR|WB|WN|WP;
     BOCC = BK|BQ|BR|BB|BN|BP;
     OCC = WOCC|BOCC;
@@ -851,10 +1436,20 @@ void MoveGen( U8 *listStoreTo ) {
     EWOCC = WOCC|ENPSQ;
     EBOCC = BOCC|ENPSQ;
 
+    if(mgc!=NULL && !(mg_1mv|mg_noflags) && mgcGet( listStoreTo, &mgc_set )) {
+        mg_cnt = listStoreTo;
+        mg_po = listStoreTo+1+((*mg_cnt)<<2);
+        return;
+        }
+
     mg_cnt = mg_po = listStoreTo;
     mg_po++;
     *(mg_cnt)=0;
 
+#ifdef mg_CHECK_FLAG
+    if(!(mg_1mv|mg_noflags)) prepCheckSquares();
+#endif
+
     if(ToMove){   // Black to move
 
         // King moves
@@ -1028,10 +1623,12 @@ void MoveGen( U8 *listStoreTo ) {
 
 #ifdef mg_CHECK_FLAG
     #ifdef mg_CKMATE_FLAG
-        if(!(mg_1mv)) getCheckMateFlags( listStoreTo );
+        if(!(mg_1mv|mg_noflags)) getCheckMateFlags( listStoreTo );
     #endif
 #endif
 
+    if(mgc_set!=NULL) mgcPut( listStoreTo, mgc_set );
+
 }
 
 /*
@@ -1047,6 +1644,7 @@ void SetStartPos() {
     ENPSQ = 0LL;
     CASTLES = castle_ALL;
     ToMove = 0;
+    HalfMoves = 0; FullMoves = 1;
     undo_p = undobuffer;
     mg_po = mg_cnt = mg_uci_list;
 }
@@ -1155,6 +1753,7 @@ void SetByFEN( char *pos ) {
 
     WK=WQ=WR=WB=WN=WP=0LL;
     BK=BQ=BR=BB=BN=BP=0LL;
+    HalfMoves = 0; FullMoves = 1;
 
         for(i=0;;i++)
         {
@@ -1193,12 +1792,136 @@ void SetByFEN( char *pos ) {
         sq = (((pos[i+1]-'1')<<3) | ((pos[i]-'a')&7));
         ENPSQ = (1LL<<sq);
         }
+                        // clocks, if any
+    while(pos[i]!=0 && pos[i]!=' ') i++;
+    while(pos[i]==' ') i++;
+    for(j=0; pos[i]>='0' && pos[i]<='9'; i++) j = j*10+(pos[i]-'0');
+    HalfMoves = j;
+    while(pos[i]==' ') i++;
+    for(j=0; pos[i]>='0' && pos[i]<='9'; i++) j = j*10+(pos[i]-'0');
+    if(j>0) FullMoves = j;
 
     undo_p = undobuffer;
     mg_po = mg_cnt = mg_uci_list;
 
 }
 
+/*
+    Compact binary position, POS_BYTES at most:
+        8 bytes occupancy (little-endian), then 4-bit code of each piece
+        in order of squares, low nibble first, zero-padded.
+    Codes are PIECES[] indexes, and the unused ones carry the flags:
+        6,14 - rook with castling right,
+        7 - pawn just moved two squares (en-passant square behind it),
+        15 - black king, black to move.
+*/
+
+#define POS_BYTES 24
+
+int PosEncode( U8 *b ) {
+
+    U8 box[64], j, i = 0, sq;
+    U64 o, occ = 0;
+
+    for(j=0;j<14;j++) {
+        if(j==6) j=8;
+        o = *(PIECES[j]);
+        occ |= o;
+        for(; o; o&=o-1) box[trail0(o)] = j;
+        }
+    if((CASTLES&castle_E1H1)==castle_E1H1 && (WR&(1LL<<7))) box[7] = 6;
+    if((CASTLES&castle_E1C1)==castle_E1C1 && (WR&1LL)) box[0] = 6;
+    if((CASTLES&castle_E8H8)==castle_E8H8 && (BR&(1LL<<63))) box[63] = 14;
+    if((CASTLES&castle_E8C8)==castle_E8C8 && (BR&(1LL<<56))) box[56] = 14;
+    if(ENPSQ) {
+        sq = trail0(ENPSQ);
+        if(sq<32) { if(WP & (ENPSQ<<8)) box[sq+8] = 7; }
+        else { if(BP & (ENPSQ>>8)) box[sq-8] = 7; }
+        }
+    if(ToMove && BK) box[trail0(BK)] = 15;
+
+    for(j=0; j<8; j++) b[j] = (U8)(occ>>(j<<3));
+    for(j=8; j<POS_BYTES; j++) b[j] = 0;
+    for(o=occ; o && i<((POS_BYTES-8)<<1); o&=o-1, i++) {
+        b[8+(i>>1)] |= (box[trail0(o)]<<((i&1)<<2));
+        }
+    return 8+((i+1)>>1);
+}
+
+U8 PosDecode( const U8 *b ) {
+
+    U64 occ = 0, o;
+    U8 i = 0, c, sq;
+
+    for(c=0; c<8; c++) occ |= ((U64)b[c])<<(c<<3);
+    WK=WQ=WR=WB=WN=WP=0LL;
+    BK=BQ=BR=BB=BN=BP=0LL;
+    CASTLES = ENPSQ = 0LL;
+    ToMove = 0;
+    HalfMoves = 0; FullMoves = 1;
+
+    for(o=occ; o; o&=o-1, i++) {
+        if(i>=((POS_BYTES-8)<<1)) return 0;
+        sq = trail0(o);
+        c = (b[8+(i>>1)]>>((i&1)<<2))&15;
+        switch(c) {
+            case 6:
+                if(sq==7) CASTLES |= castle_E1H1;
+                else if(sq==0) CASTLES |= castle_E1C1;
+                else return 0;
+                c = 1;
+                break;
+            case 14:
+                if(sq==63) CASTLES |= castle_E8H8;
+                else if(sq==56) CASTLES |= castle_E8C8;
+                else return 0;
+                c = 9;
+                break;
+            case 7:
+                if((sq>>3)==3) { ENPSQ = (1LL<<(sq-8)); c = 4; }
+                else if((sq>>3)==4) { ENPSQ = (1LL<<(sq+8)); c = 12; }
+                else return 0;
+                break;
+            case 15:
+                ToMove = 1;
+                c = 13;
+                break;
+            }
+        *(PIECES[c]) |= (1LL<<sq);
+        }
+
+    undo_p = undobuffer;
+    mg_po = mg_cnt = mg_uci_list;
+    return 1;
+}
+
+/*
+    Hash of pieces, castlings, en-passant and side to move,
+    for transposition tables of searches.
+*/
+U64 BoardHash() {
+
+    U64 h = (ToMove ? 0x2545F4914F6CDD1DLL : 0LL);
+    U8 j;
+
+    for(j=0;j<14;j++) {
+        if(j==6) j=8;
+        h = (h ^ *(PIECES[j])) * 0x9E3779B97F4A7C15LL;
+        h ^= (h>>32);
+        }
+    h = (h ^ CASTLES ^ ENPSQ) * 0x9E3779B97F4A7C15LL;
+    return (h ^ (h>>29));
+}
+
+// number to string, returns length
+int sNum( char *s, int v ) {
+    char d[12];
+    int n = 0, i = 0;
+    do { d[n++] = '0'+(v%10); v /= 10; } while(v>0);
+    while(n>0) s[i++] = d[--n];
+    return i;
+}
+
 /*
     Gets current uci FEN of position
 */
@@ -1248,9 +1971,9 @@ void sGetFEN( char *buffer ) {
                 s[i++] = ('1'+(sq>>3));
                 }
         s[i++]=' ';
-        s[i++]='0';
+        i += sNum( s+i, HalfMoves );
         s[i++]=' ';
-        s[i++]='1';
+        i += sNum( s+i, FullMoves );
         s[i]=0;
 }
 
@@ -1271,52 +1994,104 @@ U8 IsCheckMateNow() {
 
     isCheckedKing();
     if(mg_fA) {
-        mg_1mv = 1;
-        mg_p2 = mg_po;
-        mg_c2 = mg_cnt;
-        MoveGen(mg_ck_list);
-        mg_fA = ((*mg_cnt) ? 0 : 1);
-        mg_1mv = 0;
-        mg_po = mg_p2;
-        mg_cnt = mg_c2;
+        mg_fA = (HasEvasion() ? 0 : 1);
     }
     return mg_fA;
 }
 
+// en-passant square, if side to move has a pawn to capture
+U64 epCapture( U64 ep, U8 side, U64 wp, U64 bp ) {
+    if(!ep) return 0LL;
+    if(side) return ((WhitePawnsAttacks(ep) & bp) ? ep : 0LL);
+    return ((BlackPawnsAttacks(ep) & wp) ? ep : 0LL);
+}
+
+/*
+    Count of the current position in game, 1 if it is new.
+    Positions are in undo buffer, looks back to the last capture
+    or pawn move only, same side to move each 2 plies.
+*/
+U8 Repetitions() {
+
+    U64 *u, ep = epCapture( ENPSQ, ToMove, WP, BP );
+    int k, back = HalfMoves, plies = (int)((undo_p-undobuffer)/UNDO_REC);
+    U8 n = 1;
+
+    if(back>plies) back = plies;
+    for(k=4; k<=back; k+=2) {
+        u = undo_p-(k*UNDO_REC);
+        if(u[4]==WP && u[10]==BP && u[5]==WK && u[11]==BK &&
+            u[0]==WQ && u[1]==WR && u[2]==WB && u[3]==WN &&
+            u[6]==BQ && u[7]==BR && u[8]==BB && u[9]==BN &&
+            u[12]==CASTLES && epCapture( u[13], ToMove, u[4], u[10] )==ep) n++;
+        }
+    return n;
+}
+
+/*
+    Nobody can checkmate: kings only, with a single knight or bishop,
+    or with bishops on squares of one colour.
+*/
+U8 InsufficientMaterial() {
+
+    U64 m = WB|WN|BB|BN;
+
+    if(WQ|WR|WP|BQ|BR|BP) return 0;
+    if(!(m&(m-1))) return 1;
+    if(WN|BN) return 0;
+    return ((!(m & 0x55AA55AA55AA55AALL)) || (!(m & 0xAA55AA55AA55AA55LL)));
+}
+
+#define GAME_ON 0
+#define GAME_CHECKMATE 1
+#define GAME_STALEMATE 2
+#define GAME_NOMATERIAL 3
+#define GAME_THREEFOLD 4            // may be claimed
+#define GAME_FIFTY 5                // may be claimed
+
+U8 GameStatus() {
+
+    U8 list[4<<8], f = mg_noflags;
+
+    if(IsCheckMateNow()) return GAME_CHECKMATE;
+    if(!mg_fA) {                    // not in check+
+        mg_noflags = 1;
+        MoveGen( list );
+        mg_noflags = f;
+        if(list[0]==0) return GAME_STALEMATE;
+        }
+    if(InsufficientMaterial()) return GAME_NOMATERIAL;
+    if(Repetitions()>=3) return GAME_THREEFOLD;
+    if(HalfMoves>=100) return GAME_FIFTY;
+    return GAME_ON;
+}
+
 /*
     mstr is "e2e4", "b7a8q", "e1g1",...
+    Verifies the move itself, no MoveGen of all moves.
 
     Returns 1 if made or 0 if error
 */
 
 U8 uciMove( char *mstr ) {
 
-    U8 sq1 = (((mstr[1]-'1')<<3)|((mstr[0]-'a')&7));
-    U8 sq2 = (((mstr[3]-'1')<<3)|((mstr[2]-'a')&7));
-    U8 pr = mstr[4];
-    U8 *p = mg_uci_list;
+    U8 *mv = mg_uci_mv;
+    char pr;
 
-    mg_p2 = mg_po;
-    mg_c2 = mg_cnt;
-    MoveGen(p++);
-    mg_pN = *(mg_cnt);
-    mg_po = mg_p2;
-    mg_cnt = mg_c2;
+    if(!uciValid( mstr )) return 0;
+    pr = mstr[4];
+    if(pr>='A' && pr<='Z') return 0;        // lowercase only
 
-    for(mg_pI=0; mg_pI<mg_pN; mg_pI++) {
-        mg_sq = *(p+1);
-        mg_sqTo = *(p+2);
-        mg_fl = *(p+3);
-
-        if( mg_sq==sq1 && mg_sqTo==sq2 &&
-                ((pr==0)||(pr==pieces[8+((mg_fl>>2)&3)])) ) {
-            DoMove(p);
-            mg_uci_po = p;
-            return 1;
-            }
-        p += 4;
+    if(!uciToMv( mstr, mv ) || !IsPseudoLegal( mv )) return 0;
+    if(!(mv[3]&2) && pr!=0 && pr!='q') return 0;
+
+    DoMove( mv );
+    if(MoverInCheck()) {
+        UnDoMove();
+        return 0;
         }
-    return 0;
+    mg_uci_po = mv;
+    return 1;
 }
 
 /*
@@ -1428,18 +2203,139 @@ void Sample2() {        // Set position and simple search
 
 */
 
+/*
+    Slider tables file: 64 bytes header (magic, check of magic numbers,
+    checksum of tables), then BishopLegalsTable, RookLegalsTable. Mapped read-only, so
+    all processes of host share one copy in page cache.
+*/
+
+#define TBL_MAGIC "U64TBL01"
+#define TBL_SLIDERS (2*64*(1<<16))      // U64 of both tables
+
+U64 *tbl_mem = NULL;                    // tables calculated here, if not mapped
+const U8 *tbl_map = NULL;
+
+U64 tblCheck() {
+    U64 h = TBL_SLIDERS;
+    U8 i;
+    for(i=0; i<64; i++) {
+        h = (h ^ BishopMagics[i]) * 0x9E3779B97F4A7C15LL;
+        h = (h ^ RookMagics[i]) * 0x9E3779B97F4A7C15LL;
+        }
+    return h;
+}
+
+// of tables, 4 lanes to be fast
+U64 tblSum( const U64 *t ) {
+    U64 h[4] = { 1, 2, 3, 4 };
+    long long i;
+    for(i=0; i<TBL_SLIDERS; i+=4) {
+        h[0] = (h[0] ^ t[i]) * 0x9E3779B97F4A7C15LL;
+        h[1] = (h[1] ^ t[i+1]) * 0x9E3779B97F4A7C15LL;
+        h[2] = (h[2] ^ t[i+2]) * 0x9E3779B97F4A7C15LL;
+        h[3] = (h[3] ^ t[i+3]) * 0x9E3779B97F4A7C15LL;
+        }
+    return h[0] ^ (h[1]>>7) ^ (h[2]<<11) ^ (h[3]>>19) ^ (h[1]<<23);
+}
+
+U8 tblMap( char *path ) {
+#ifndef _WIN32
+    struct stat st;
+    U64 hd[8];
+    const U8 *p;
+    int fd = open( path, O_RDONLY|O_NOFOLLOW );
+
+    if(fd<0) return 0;
+    if(fstat( fd, &st )!=0 || (st.st_uid!=getuid() && st.st_uid!=0) ||
+        st.st_size!=64+TBL_SLIDERS*8LL || read( fd, hd, 64 )!=64 ||
+        memcmp( hd, TBL_MAGIC, 8 )!=0 || hd[1]!=tblCheck()) {
+        close(fd);
+        return 0;
+        }
+    p = (const U8 *)mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close(fd);
+    if(p==(const U8 *)MAP_FAILED) return 0;
+    if(tblSum( (const U64 *)(p+64) )!=hd[2]) {     // damaged, rebuilt
+        munmap( (void *)p, st.st_size );
+        return 0;
+        }
+    tbl_map = p;
+    BishopLegalsTable = (U64 (*)[1<<16])(p+64);
+    RookLegalsTable = BishopLegalsTable+64;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+// new temporary file (mkstemp), then renamed, so others map whole tables or none
+U8 tblWrite( char *path ) {
+#ifndef _WIN32
+    char tmp[1100];
+    U64 hd[8];
+    FILE *f;
+    int fd;
+    U8 ok;
+
+    if(strlen(path)>1024) return 0;
+    sprintf( tmp, "%s.XXXXXX", path );
+    memset( hd, 0, sizeof(hd) );
+    memcpy( hd, TBL_MAGIC, 8 );
+    hd[1] = tblCheck();
+    hd[2] = tblSum( tbl_mem );
+    fd = mkstemp( tmp );
+    if(fd<0) return 0;
+    fchmod( fd, 0644 );
+    f = fdopen( fd, "wb" );
+    if(f==NULL) { close(fd); remove( tmp ); return 0; }
+    ok = (fwrite( hd, 1, 64, f )==64 && fwrite( tbl_mem, 8, TBL_SLIDERS, f )==TBL_SLIDERS);
+    if(fclose( f )!=0) ok = 0;
+    if(ok) ok = (rename( tmp, path )==0);
+    if(!ok) remove( tmp );
+    return ok;
+#else
+    return 0;
+#endif
+}
+
 /*
     OneTime Init
     Call in main.
+    Slider tables are mapped of file at path, if it is there
+    (no calculation at all), or calculated and written there for
+    the next processes. path NULL or "": calculated in memory only.
+    Returns 0 if no memory.
 */
-void Init_u64_chess() {
+U8 Init_u64_chess_file( char *path ) {
+
+    U8 file = (path!=NULL && path[0]!=0);
+
+    tbl_sliders = !(file && tblMap( path ));
+    if(tbl_sliders) {
+        tbl_mem = (U64 *)calloc( TBL_SLIDERS, sizeof(U64) );
+        if(tbl_mem==NULL) return 0;
+        BishopLegalsTable = (U64 (*)[1<<16])tbl_mem;
+        RookLegalsTable = BishopLegalsTable+64;
+        }
     prepare_tables();
     prepare_knights();
     prepare_kings();
+    if(tbl_mem!=NULL && file && tblWrite( path ) && tblMap( path )) {
+        free( tbl_mem );
+        tbl_mem = NULL;
+        }
     SetStartPos();
 
     //Sample1();
     //Sample2();
+    return 1;
+}
+
+void Init_u64_chess() {
+    if(!Init_u64_chess_file( NULL )) {
+        printf("No memory for chess tables.\n");
+        exit(1);
+        }
 }
 
 #endif  /* _INC_u64_CHESS */
@@ -0,0 +1,1115 @@
+/*
+ ---------------------------------------------
+
+    u64_egtb  endgame tables for u64_chess
+
+    Probing of endgame tables against the current board.
+    Tables register their probe functions with count of pieces
+    they cover, so any native search can ask at leaf nodes
+    (TbProbeWDL) without knowing which tables exist.
+
+    Values are of side to move, as Syzygy tables give them.
+
+    Bitbases of king and piece vs king are generated in memory
+    by retrograde analysis, no files needed.
+
+    Syzygy WDL and DTZ files are probed natively, mapped from disk.
+
+---------------------------------------------
+*/
+
+#ifndef _INC_u64_EGTB
+#define _INC_u64_EGTB
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "u64_chess.h"
+#include "u64_pgn.h"
+
+#define TB_LOSS -2
+#define TB_BLESSED_LOSS -1      // lost, but drawn by 50 moves rule
+#define TB_DRAW 0
+#define TB_CURSED_WIN 1         // won, but drawn by 50 moves rule
+#define TB_WIN 2
+#define TB_NONE -1000           // not in tables
+
+typedef int (*TbProbe)();       // value of current board or TB_NONE
+
+#define TB_TABLES 16
+
+TbProbe tb_wdl[TB_TABLES];      // win-draw-loss
+TbProbe tb_dtz[TB_TABLES];      // distance to zeroing move in plies, +win -loss, or NULL
+U8 tb_pcs[TB_TABLES];           // max pieces of table
+U8 tb_cnt = 0;
+U8 tb_maxpcs = 0;
+
+U8 tbPieces() {
+    U64 o = WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP;
+    U8 n = 0;
+    for(; o; o&=o-1) n++;
+    return n;
+}
+
+/*
+    Adds a table, returns 1 if ok or 0 if too many
+*/
+U8 TbRegister( TbProbe wdl, TbProbe dtz, U8 pieces ) {
+    if(tb_cnt>=TB_TABLES) return 0;
+    tb_wdl[tb_cnt] = wdl;
+    tb_dtz[tb_cnt] = dtz;
+    tb_pcs[tb_cnt++] = pieces;
+    if(pieces>tb_maxpcs) tb_maxpcs = pieces;
+    return 1;
+}
+
+/*
+    WDL of current board, TB_NONE if no table knows it.
+    Cheap when there are more pieces than any table covers.
+*/
+int TbProbeWDL() {
+    U8 i, n;
+    int v;
+    if(tb_cnt==0 || (n = tbPieces())>tb_maxpcs) return TB_NONE;
+    for(i=0; i<tb_cnt; i++) {
+        if(n<=tb_pcs[i] && (v = tb_wdl[i]())!=TB_NONE) return v;
+        }
+    return TB_NONE;
+}
+
+int TbProbeDTZ() {
+    U8 i, n;
+    int v;
+    if(tb_cnt==0 || (n = tbPieces())>tb_maxpcs) return TB_NONE;
+    for(i=0; i<tb_cnt; i++) {
+        if(n<=tb_pcs[i] && tb_dtz[i]!=NULL && (v = tb_dtz[i]())!=TB_NONE) return v;
+        }
+    return TB_NONE;
+}
+
+/*
+    Best legal move of current board by tables, written to mv[4].
+    Keeps the best result, then winning side prefers zeroing moves,
+    and if tables have DTZ shortest DTZ, losing side longest.
+    Mates win, stalemates and insufficient material draw without
+    probing, moves into positions no table covers are skipped.
+    Returns WDL after the move, TB_NONE if no move is known.
+*/
+int TbRootMove( U8 *mv ) {
+
+    U8 list[4<<8], reply[4<<8], *p;
+    int i, n, w, d, r, best = TB_NONE, bestr = 0;
+
+    MoveGen( list );
+    n = list[0];
+    for(i=0, p=list+1; i<n; i++, p+=4) {
+        DoMove( p );
+        d = TB_NONE;
+        r = 0;                              // rank among same results
+        if(p[3]&128) { w = TB_WIN; r = 1; }       // checkmate
+        else if(InsufficientMaterial()) w = TB_DRAW;
+        else if(!(p[3]&64) && (MoveGen( reply ), reply[0]==0)) w = TB_DRAW;    // stalemate
+        else if((w = TbProbeWDL())!=TB_NONE) { w = -w; d = TbProbeDTZ(); }
+        UnDoMove();
+        if(w==TB_NONE) continue;
+
+        if(d==TB_NONE) { if(w>0 && r==0 && !(p[3]&1) && (p[0]&7)!=4) r = -1; }     // zeroing moves progress
+        else if(w!=TB_DRAW) {
+            if(d<0) d = -d;
+            if(w>0) r = ((p[3]&1) || (p[0]&7)==4 ? 0 : -1-d);
+            else r = d;
+            }
+        if(best==TB_NONE || w>best || (w==best && r>bestr)) {
+            best = w; bestr = r;
+            memcpy( mv, p, 4 );
+            }
+        }
+    return best;
+}
+
+/*
+    Bitbases: 1 bit per position, win of the side with the piece.
+    Index of white king, piece, vs black king: side to move, kings,
+    square of piece. Board is mirrored so that white king is in
+    a1-d1-d4 triangle (10 squares), or with pawn, so that pawn is
+    on files a-d (24 squares).
+*/
+
+#define BB_UNKNOWN 0
+#define BB_ILLEGAL 1
+#define BB_DRAW 2
+#define BB_WIN 3
+
+U8 *bb_win[5];          // by piece type 0-Q,1-R,2-B,3-N,4-P, NULL if not generated
+U8 bb_registered = 0;
+
+CONST U8 bb_tri[64] = {
+    0, 1, 2, 3, 0, 0, 0, 0,     0, 4, 5, 6, 0, 0, 0, 0,
+    0, 0, 7, 8, 0, 0, 0, 0,     0, 0, 0, 9, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,     0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0,     0, 0, 0, 0, 0, 0, 0, 0 };
+
+#define bbInTriangle(sq) (((sq)&7)<4 && ((sq)>>3)<=((sq)&7))
+#define bbTranspose(sq) ((((sq)&7)<<3)|((sq)>>3))
+
+int bbSize( U8 t ) {            // bits
+    return (t==4 ? 2*64*64*24 : 2*10*64*64);
+}
+
+int bbIndex( U8 t, U8 stm, U8 wk, U8 bk, U8 xs ) {
+    U8 f;
+    if(t==4) {
+        if(xs&4) { wk^=7; bk^=7; xs^=7; }
+        xs = ((((xs>>3)-1)<<2)|(xs&7));
+        return ((((stm<<6)|wk)<<6)|bk)*24+xs;
+        }
+    f = ((wk&4) ? 7 : 0)|((wk&32) ? 56 : 0);
+    wk ^= f; bk ^= f; xs ^= f;
+    if((wk>>3)>(wk&7)) { wk = bbTranspose(wk); bk = bbTranspose(bk); xs = bbTranspose(xs); }
+    return ((((stm*10)+bb_tri[wk])<<6)|bk)*64+xs;
+}
+
+U64 bbAttacks( U8 t, U8 sq, U64 occ ) {
+    switch(t) {
+        case 0: return (getRookMove(sq,occ)|getBishopMove(sq,occ));
+        case 1: return getRookMove(sq,occ);
+        case 2: return getBishopMove(sq,occ);
+        case 3: return KnightLegals[sq];
+        }
+    return WhitePawnsAttacks(1LL<<sq);
+}
+
+U8 bbWin( U8 t, U8 stm, U8 wk, U8 bk, U8 xs ) {
+    int i = bbIndex( t, stm, wk, bk, xs );
+    return ((bb_win[t][i>>3]>>(i&7))&1);
+}
+
+/*
+    State of position by states of positions after each move
+*/
+U8 bbEval( U8 *st, U8 t, U8 stm, U8 wk, U8 bk, U8 xs ) {
+
+    U64 occ = (1LL<<wk)|(1LL<<bk)|(1LL<<xs), a;
+    U8 to, c, any = 0, unknown = 0;
+
+    if(stm) {       // black: draw if any move draws, win if all moves lose
+        a = KingLegals[bk] & ~KingLegals[wk];
+        for(; a; a&=a-1) {
+            to = trail0(a);
+            c = (to==xs ? BB_DRAW : st[bbIndex( t, 0, wk, to, xs )]);     // capture leaves kings
+            if(c==BB_ILLEGAL) continue;
+            if(c==BB_DRAW) return BB_DRAW;
+            if(c==BB_UNKNOWN) unknown = 1;
+            any = 1;
+            }
+        if(!any) return ((bbAttacks( t, xs, occ )&(1LL<<bk)) ? BB_WIN : BB_DRAW);
+        return (unknown ? BB_UNKNOWN : BB_WIN);
+        }
+
+    // white: win if any move wins, draw if all moves draw
+    a = KingLegals[wk] & ~KingLegals[bk] & ~(1LL<<xs);
+    for(; a; a&=a-1) {
+        c = st[bbIndex( t, 1, trail0(a), bk, xs )];
+        if(c==BB_WIN) return BB_WIN;
+        if(c==BB_UNKNOWN) unknown = 1;
+        }
+    if(t==4) {
+        to = xs+8;
+        if(!(occ&(1LL<<to))) {
+            if(to>55) {             // promotes, queen or rook (to avoid stalemate)
+                if(bbWin( 0, 1, wk, bk, to ) || bbWin( 1, 1, wk, bk, to )) return BB_WIN;
+                }
+            else {
+                c = st[bbIndex( t, 1, wk, bk, to )];
+                if(c==BB_WIN) return BB_WIN;
+                if(c==BB_UNKNOWN) unknown = 1;
+                if(xs<16 && !(occ&(1LL<<(to+8)))) {
+                    c = st[bbIndex( t, 1, wk, bk, to+8 )];
+                    if(c==BB_WIN) return BB_WIN;
+                    if(c==BB_UNKNOWN) unknown = 1;
+                    }
+                }
+            }
+        }
+    else {
+        a = bbAttacks( t, xs, occ ) & ~occ;
+        for(; a; a&=a-1) {
+            c = st[bbIndex( t, 1, wk, bk, trail0(a) )];
+            if(c==BB_WIN) return BB_WIN;
+            if(c==BB_UNKNOWN) unknown = 1;
+            }
+        }
+    return (unknown ? BB_UNKNOWN : BB_DRAW);
+}
+
+/*
+    WDL of current board by bitbases, TB_NONE if not generated.
+    Bare kings and king with bishop or knight vs king are draws.
+*/
+int BitbaseProbe() {
+
+    U64 w = WQ|WR|WB|WN|WP, b = BQ|BR|BB|BN|BP, o;
+    U8 t, stm, wk, bk, xs;
+
+    if(CASTLES) return TB_NONE;
+    if((w|b)==0) return TB_DRAW;
+    if((w && b) || ((w|b)&((w|b)-1))) return TB_NONE;
+    for(t=0; t<5; t++) {
+        o = *PIECES[(w ? 0 : 8)+t];
+        if(o) break;
+        }
+    if(t==2 || t==3) return TB_DRAW;            // lone bishop or knight, underpromotions of KPK
+    if(bb_win[t]==NULL) return TB_NONE;
+    if(t==4 && (o&0xFF000000000000FFLL)) return TB_NONE;
+    if(w) { stm = ToMove; wk = trail0(WK); bk = trail0(BK); xs = trail0(o); }
+    else {          // colours swapped, board flipped
+        stm = ToMove^1; wk = trail0(BK)^56; bk = trail0(WK)^56; xs = trail0(o)^56;
+        }
+    if(!bbWin( t, stm, wk, bk, xs )) return TB_DRAW;
+    return (stm ? TB_LOSS : TB_WIN);
+}
+
+/*
+    Generates bitbase of white king and piece t (0-Q..4-P) vs black king.
+    Pawns promote into KQK, KRK, so these are generated before.
+    Positions not resolved when iterations change nothing are draws.
+    Returns bytes of bitbase, or 0 if no memory.
+*/
+int BitbaseGen( U8 t ) {
+
+    int n = bbSize(t), i, j, cnt = 0, last;
+    U8 *st, stm, wk, bk, xs, c;
+    unsigned int *todo, u;          // positions to resolve, packed
+    U64 occ;
+
+    if(t>4) return 0;
+    if(bb_win[t]!=NULL) return (n>>3);
+    if(t==4 && (BitbaseGen(0)==0 || BitbaseGen(1)==0)) return 0;
+
+    st = (U8 *)calloc( n, 1 );
+    todo = (unsigned int *)malloc( n*sizeof(unsigned int) );
+    bb_win[t] = (U8 *)calloc( n>>3, 1 );
+    if(st==NULL || todo==NULL || bb_win[t]==NULL) {
+        free( st ); free( todo ); free( bb_win[t] );
+        bb_win[t] = NULL;
+        return 0;
+        }
+
+    for(stm=0; stm<2; stm++)
+    for(wk=0; wk<64; wk++)
+    for(bk=0; bk<64; bk++)
+    for(xs=(t==4 ? 8 : 0); xs<(t==4 ? 56 : 64); xs++) {
+        if(t==4 ? (xs&4) : !bbInTriangle(wk)) continue;
+        occ = (1LL<<wk)|(1LL<<xs);
+        if(wk==bk || (occ&(1LL<<bk)) || (KingLegals[wk]&(1LL<<bk)) ||
+            (stm==0 && (bbAttacks( t, xs, occ )&(1LL<<bk))))
+            st[bbIndex( t, stm, wk, bk, xs )] = BB_ILLEGAL;
+        else todo[cnt++] = (stm<<18)|(wk<<12)|(bk<<6)|xs;
+        }
+
+    do {                            // until nothing changes
+        last = cnt;
+        for(i=j=0; i<cnt; i++) {
+            u = todo[i];
+            stm = (u>>18); wk = (u>>12)&63; bk = (u>>6)&63; xs = u&63;
+            c = bbEval( st, t, stm, wk, bk, xs );
+            if(c==BB_UNKNOWN) todo[j++] = u;
+            else st[bbIndex( t, stm, wk, bk, xs )] = c;
+            }
+        cnt = j;
+        } while(cnt<last);
+
+    for(i=0; i<n; i++) {
+        if(st[i]==BB_WIN) bb_win[t][i>>3] |= (1<<(i&7));
+        }
+    free( st );
+    free( todo );
+
+    if(!bb_registered) bb_registered = TbRegister( BitbaseProbe, NULL, 3 );
+    return (n>>3);
+}
+
+/*
+    Generates bitbases of signatures as "KPK KRK KQK".
+    Returns bytes of all generated bitbases, or 0 if a signature is unknown.
+*/
+int BitbaseBuild( char *sigs ) {
+
+    const char *pcs = "QRBNP", *c;
+    U8 t;
+    int bytes = 0;
+
+    while(*sigs) {
+        if(*sigs==' ' || *sigs==',') { sigs++; continue; }
+        if(sigs[0]!='K' || sigs[1]==0 || sigs[2]!='K' ||
+            (c = strchr( pcs, sigs[1] ))==NULL) return 0;
+        if(BitbaseGen( (U8)(c-pcs) )==0) return 0;
+        sigs += 3;
+        }
+    for(t=0; t<5; t++) {
+        if(bb_win[t]!=NULL) bytes += bbSize(t)>>3;
+        }
+    return bytes;
+}
+
+//------------------------------------------
+//
+//	Syzygy tables
+//
+//  .rtbw (WDL) and .rtbz (DTZ) files as the generator writes them.
+//  SyzygyInit lists the files of directories, a file is mapped at first
+//  probe of its material. Values are stored in blocks of canonical Huffman
+//  codes, each symbol a pair of symbols (Recursive Pairing) down to values.
+//  Positions are indexed as the generator does: pawns by files a-d, or
+//  kings (or 3 unique pieces) in a1-d1-d4 triangle, then groups of same
+//  pieces as combinations of free squares.
+//  Checked only against files written to this layout here (KQvK, KRvK,
+//  KPvK, KBvK, KNvK against bitbases, DTZ against retrograde DTM), not
+//  yet against files of the generator.
+//
+
+#define SZ_PIECES 7
+#define SZ_DIRS 16
+#define SZ_PATH 1024
+
+#define SZ_WDL 0
+#define SZ_DTZ 1
+
+#define SZ_OK 0
+#define SZ_FAIL 1
+#define SZ_CHANGE_STM 2         // DTZ stored for other side
+#define SZ_ZEROING 3            // best move is a capture or pawn move
+
+// flags of table data
+#define SZ_STM 1
+#define SZ_MAPPED 2
+#define SZ_WINPLIES 4
+#define SZ_LOSSPLIES 8
+#define SZ_WIDE 16
+#define SZ_SINGLE 128
+
+typedef struct {
+    U8 flags;
+    U8 pieces[SZ_PIECES];       // codes 1-P..6-K, +8 black, order of encoding
+    int groupLen[SZ_PIECES+1];  // pieces in groups, 0 terminated
+    U64 groupIdx[SZ_PIECES+1];  // multiplier of group, last is size of table
+    U64 blockSize, span, sparseSize;
+    int blocks, blockLenSize, minLen, maxLen, syms;
+    const U8 *lowestSym;        // U16 first symbol of each code length
+    const U8 *btree;            // 3 bytes per symbol: 12 bits left, 12 bits right
+    const U8 *blockLen;         // U16 values in block -1
+    const U8 *sparse;           // U32 block, U16 offset every span values
+    const U8 *data;             // blocks
+    U64 *base64;                // lowest code of each length, left aligned
+    U8 *symLen;                 // values of symbol -1
+    U16 mapIdx[4];              // DTZ maps of win, loss, cursed win, blessed loss
+} SzPairs;
+
+typedef struct {
+    char name[SZ_PIECES+2];     // as "KRPvKR"
+    U64 key, key2;              // material, and with colours swapped
+    U8 pcs, pawns, unique, pawnCnt[2];     // pawns of leading colour, other
+    U8 dir[2];                  // directory +1 of wdl, dtz file, 0 if none
+    U8 ready[2];                // 0 not mapped yet, 1 mapped, 2 failed
+    const U8 *map[2];
+    long long size[2];
+    const U8 *dtzMap;
+    SzPairs wdl[2][4], dtz[4];  // [side][file a-d]
+} SzTable;
+
+SzTable *sz_tab = NULL;
+int sz_cnt = 0, sz_hsize = 0;
+int *sz_hash = NULL;            // index+1 by material key
+char sz_dir[SZ_DIRS][SZ_PATH];
+U8 sz_dirs = 0, sz_maxpcs = 0, sz_inited = 0, sz_registered = 0;
+
+int sz_binom[6][64];            // k of n
+int sz_mapPawns[64];            // a2-h7 to 47..0, leading pawn has most
+int sz_mapB1H1H7[64];
+int sz_mapA1D1D4[64];
+int sz_mapKK[10][64];
+int sz_leadIdx[6][64];
+int sz_leadSize[6][4];
+
+CONST U8 sz_code[6] = { 5, 4, 3, 2, 1, 6 };         // Q R B N P K of PIECES to codes
+CONST int sz_wdlMap[5] = { 1, 3, 0, 2, 0 };
+
+#define szOff(sq) (((sq)>>3)-((sq)&7))      // rank-file, <0 below a1-h8
+#define szLE16(p) ((p)[0]|((p)[1]<<8))
+#define szLE32(p) ((U32)szLE16(p)|((U32)szLE16((p)+2)<<16))
+#define szBE32(p) (((U32)(p)[0]<<24)|((U32)(p)[1]<<16)|((U32)(p)[2]<<8)|(p)[3])
+#define szLeft(d,s) ((((d)->btree[3*(s)+1]&15)<<8)|(d)->btree[3*(s)])
+#define szRight(d,s) (((d)->btree[3*(s)+2]<<4)|((d)->btree[3*(s)+1]>>4))
+#define szSign(v) (((v)>0)-((v)<0))
+
+void szInit() {
+
+    int i, k, n, f, r, sq, s1, s2, code, avail = 47, both[64][2], nb = 0;
+
+    if(sz_inited) return;
+    sz_inited = 1;
+
+    for(sq=code=0; sq<64; sq++) if(szOff(sq)<0) sz_mapB1H1H7[sq] = code++;
+
+    for(sq=code=0; sq<28; sq++) if(szOff(sq)<0 && (sq&7)<4) sz_mapA1D1D4[sq] = code++;
+    for(sq=0; sq<28; sq++) if(szOff(sq)==0 && (sq&7)<4) sz_mapA1D1D4[sq] = code++;
+
+    // first king in triangle, if on diagonal second not above it, both on diagonal last
+    for(i=code=0; i<10; i++)
+    for(s1=0; s1<28; s1++) {
+        if(sz_mapA1D1D4[s1]!=i || (i==0 && s1!=1)) continue;
+        for(s2=0; s2<64; s2++) {
+            if(s1==s2 || (KingLegals[s1]&(1LL<<s2))) continue;
+            if(szOff(s1)==0 && szOff(s2)>0) continue;
+            if(szOff(s1)==0 && szOff(s2)==0) { both[nb][0] = i; both[nb++][1] = s2; }
+            else sz_mapKK[i][s2] = code++;
+            }
+        }
+    for(i=0; i<nb; i++) sz_mapKK[both[i][0]][both[i][1]] = code++;
+
+    sz_binom[0][0] = 1;
+    for(n=1; n<64; n++)
+    for(k=0; k<6 && k<=n; k++)
+        sz_binom[k][n] = (k>0 ? sz_binom[k-1][n-1] : 0) + (k<n ? sz_binom[k][n-1] : 0);
+
+    for(k=1; k<=5; k++)
+    for(f=0; f<4; f++) {
+        for(r=1, n=0; r<7; r++) {
+            sq = (r<<3)|f;
+            if(k==1) { sz_mapPawns[sq] = avail--; sz_mapPawns[sq^7] = avail--; }
+            sz_leadIdx[k][sq] = n;
+            n += sz_binom[k-1][sz_mapPawns[sq]];
+            }
+        sz_leadSize[k][f] = n;
+        }
+}
+
+/*
+    Material key: 4 bits count of each piece, white then black
+*/
+U64 szKey( U8 *w, U8 *b ) {
+    U64 k = 0;
+    U8 t;
+    for(t=0; t<6; t++) k |= ((U64)w[t]<<(t<<2))|((U64)b[t]<<(24+(t<<2)));
+    return k;
+}
+
+U64 szBoardKey() {
+    U8 c[2][6], t;
+    U64 o;
+    for(t=0; t<12; t++) {
+        c[t/6][t%6] = 0;
+        for(o=*PIECES[(t/6)*8+t%6]; o; o&=o-1) c[t/6][t%6]++;
+        }
+    return szKey( c[0], c[1] );
+}
+
+SzTable *szFind( U64 key ) {
+    int h;
+    if(sz_hsize==0) return NULL;
+    for(h=(int)((key*0x9E3779B97F4A7C15ULL)>>40)&(sz_hsize-1); sz_hash[h]; h=(h+1)&(sz_hsize-1)) {
+        if(sz_tab[sz_hash[h]-1].key==key || sz_tab[sz_hash[h]-1].key2==key) return &sz_tab[sz_hash[h]-1];
+        }
+    return NULL;
+}
+
+void szHashAdd( U64 key, int i ) {
+    int h = (int)((key*0x9E3779B97F4A7C15ULL)>>40)&(sz_hsize-1);
+    while(sz_hash[h]) h = (h+1)&(sz_hsize-1);
+    sz_hash[h] = i+1;
+}
+
+/*
+    Adds file name of directory di as "KRvKP.rtbw", ignores other files
+*/
+void szAddFile( char *fname, U8 di ) {
+
+    const char *pcs = "QRBNPK", *c;
+    char *x = strrchr( fname, '.' ), *v = strchr( fname, 'v' );
+    U8 cnt[2][6], s, t, type, n = 0;
+    U64 key;
+    SzTable *e = NULL, *a;
+    int i;
+
+    if(x==NULL || v==NULL || v>x || x-fname>SZ_PIECES+1) return;
+    if(strcmp( x, ".rtbw" )!=0 && strcmp( x, ".rtbz" )!=0) return;
+    if(fname[0]!='K' || v[1]!='K') return;
+    type = (x[4]=='z' ? SZ_DTZ : SZ_WDL);
+    memset( cnt, 0, sizeof(cnt) );
+    for(c=fname; c<x; c++) {
+        if(c==v) continue;
+        if(strchr( pcs, *c )==NULL) return;
+        cnt[c>v][strchr( pcs, *c )-pcs]++;
+        n++;
+        }
+    if(cnt[0][5]!=1 || cnt[1][5]!=1) return;
+
+    key = szKey( cnt[0], cnt[1] );
+    for(i=0; i<sz_cnt && e==NULL; i++) if(sz_tab[i].key==key) e = &sz_tab[i];
+    if(e==NULL) {
+        if((sz_cnt&63)==0) {
+            a = (SzTable *)realloc( sz_tab, (sz_cnt+64)*sizeof(SzTable) );
+            if(a==NULL) return;
+            sz_tab = a;
+            }
+        e = &sz_tab[sz_cnt++];
+        memset( e, 0, sizeof(SzTable) );
+        memcpy( e->name, fname, x-fname );
+        e->key = key;
+        e->key2 = szKey( cnt[1], cnt[0] );
+        e->pcs = n;
+        e->pawns = (cnt[0][4] || cnt[1][4]);
+        for(s=0; s<2; s++) for(t=0; t<5; t++) if(cnt[s][t]==1) e->unique = 1;
+        s = (!cnt[1][4] || (cnt[0][4] && cnt[1][4]>=cnt[0][4]) ? 0 : 1);     // leading colour has less pawns
+        e->pawnCnt[0] = cnt[s][4];
+        e->pawnCnt[1] = cnt[s^1][4];
+        }
+    if(e->dir[type]==0) e->dir[type] = di+1;
+}
+
+/*
+    Groups of pieces encoded together, and their multipliers in order of file
+*/
+void szGroups( SzTable *e, SzPairs *d, U8 *order, U8 f ) {
+
+    int n = 0, first = (e->pawns ? 0 : (e->unique ? 3 : 2)), i, k, next, free;
+    U8 pp = (e->pawns && e->pawnCnt[1]);
+    U64 idx = 1;
+
+    d->groupLen[0] = 1;
+    for(i=1; i<e->pcs; i++) {
+        if(--first>0 || d->pieces[i]==d->pieces[i-1]) d->groupLen[n]++;
+        else d->groupLen[++n] = 1;
+        }
+    d->groupLen[++n] = 0;
+
+    next = (pp ? 2 : 1);
+    free = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+    for(k=0; next<n || k==order[0] || k==order[1]; k++) {
+        if(k==order[0]) {           // leading pawns or pieces
+            d->groupIdx[0] = idx;
+            idx *= (e->pawns ? sz_leadSize[d->groupLen[0]][f] : (e->unique ? 31332 : 462));
+            }
+        else if(k==order[1]) {      // other pawns
+            d->groupIdx[1] = idx;
+            idx *= sz_binom[d->groupLen[1]][48-d->groupLen[0]];
+            }
+        else {
+            d->groupIdx[next] = idx;
+            idx *= sz_binom[d->groupLen[next]][free];
+            free -= d->groupLen[next++];
+            }
+        }
+    d->groupIdx[n] = idx;
+}
+
+U8 szSymLen( SzPairs *d, int s, U8 *visited ) {
+    int l, r = szRight( d, s );
+    visited[s] = 1;
+    if(r==0xFFF) return 0;
+    l = szLeft( d, s );
+    if(l>=d->syms || r>=d->syms) return 0;
+    if(!visited[l]) d->symLen[l] = szSymLen( d, l, visited );
+    if(!visited[r]) d->symLen[r] = szSymLen( d, r, visited );
+    return d->symLen[l] + d->symLen[r] + 1;
+}
+
+/*
+    Reads sizes and Huffman codes of table data, NULL if not valid
+*/
+const U8 *szSizes( SzPairs *d, const U8 *data, const U8 *end ) {
+
+    int i, n;
+    U8 *visited;
+
+    d->flags = *data++;
+    if(d->flags & SZ_SINGLE) {      // all positions of same value
+        d->span = 1;
+        d->minLen = *data++;
+        return data;
+        }
+    for(i=0; d->groupLen[i]; i++);
+    if(end-data<10) return NULL;
+    d->blockSize = 1ULL<<(data[0]&63);
+    d->span = 1ULL<<(data[1]&63);
+    d->sparseSize = (d->groupIdx[i] + d->span - 1)/d->span;
+    d->blocks = (int)szLE32( data+3 );
+    d->blockLenSize = d->blocks + data[2];
+    d->maxLen = data[7];
+    d->minLen = data[8];
+    data += 9;
+    n = d->maxLen - d->minLen + 1;
+    if(d->minLen<1 || n<1 || d->maxLen>63 || end-data<2*n+2) return NULL;
+    d->lowestSym = data;
+
+    // canonical codes: longer codes have lower values
+    d->base64 = (U64 *)calloc( n, sizeof(U64) );
+    if(d->base64==NULL) return NULL;
+    for(i=n-2; i>=0; i--)
+        d->base64[i] = (d->base64[i+1] + szLE16( data+2*i ) - szLE16( data+2*i+2 ))/2;
+    for(i=0; i<n; i++) d->base64[i] <<= 64 - i - d->minLen;
+
+    data += 2*n;
+    d->syms = szLE16( data );
+    data += 2;
+    if(end-data<3*d->syms) return NULL;
+    d->btree = data;
+    d->symLen = (U8 *)calloc( d->syms+1, 1 );
+    visited = (U8 *)calloc( d->syms+1, 1 );
+    if(d->symLen==NULL || visited==NULL) { free( visited ); return NULL; }
+    for(i=0; i<d->syms; i++) if(!visited[i]) d->symLen[i] = szSymLen( d, i, visited );
+    free( visited );
+    return data + 3*d->syms + (d->syms&1);
+}
+
+SzPairs *szItem( SzTable *e, U8 type, U8 stm, U8 f ) {
+    if(!e->pawns) f = 0;
+    return (type==SZ_WDL ? &e->wdl[stm&1][f] : &e->dtz[f]);
+}
+
+/*
+    Sets up table from mapped file, 0 if not valid
+*/
+U8 szSetup( SzTable *e, U8 type ) {
+
+    const U8 *base = e->map[type], *data = base+4, *end = base+e->size[type];
+    U8 sides, f, files = (e->pawns ? 4 : 1), i, k, pp = (e->pawns && e->pawnCnt[1]), order[2][2];
+    SzPairs *d;
+
+    if(((data[0]&2)!=0)!=e->pawns) return 0;
+    sides = (type==SZ_WDL && e->key!=e->key2 ? 2 : 1);
+    data++;
+    for(f=0; f<files; f++) {
+        if(end-data<1+pp+e->pcs) return 0;
+        order[0][0] = data[0]&15; order[0][1] = (pp ? data[1]&15 : 15);
+        order[1][0] = data[0]>>4; order[1][1] = (pp ? data[1]>>4 : 15);
+        data += 1+pp;
+        for(k=0; k<e->pcs; k++, data++)
+        for(i=0; i<sides; i++) szItem( e, type, i, f )->pieces[k] = (i ? data[0]>>4 : data[0]&15);
+        for(i=0; i<sides; i++) szGroups( e, szItem( e, type, i, f ), order[i], f );
+        }
+    data += (data-base)&1;
+
+    for(f=0; f<files; f++)
+    for(i=0; i<sides; i++) {
+        if(data>=end || (data = szSizes( szItem( e, type, i, f ), data, end ))==NULL) return 0;
+        }
+
+    if(type==SZ_DTZ) {              // maps of values by WDL
+        e->dtzMap = data;
+        for(f=0; f<files; f++) {
+            d = szItem( e, type, 0, f );
+            if(!(d->flags & SZ_MAPPED)) continue;
+            if(d->flags & SZ_WIDE) data += (data-base)&1;
+            for(i=0; i<4; i++) {
+                if(data+2>end) return 0;
+                if(d->flags & SZ_WIDE) {
+                    d->mapIdx[i] = (U16)(((data-e->dtzMap)>>1)+1);
+                    data += 2*szLE16( data )+2;
+                    }
+                else {
+                    d->mapIdx[i] = (U16)(data-e->dtzMap+1);
+                    data += data[0]+1;
+                    }
+                }
+            }
+        data += (data-base)&1;
+        }
+
+    for(f=0; f<files; f++)
+    for(i=0; i<sides; i++) {
+        d = szItem( e, type, i, f );
+        d->sparse = data;
+        data += 6*d->sparseSize;
+        }
+    for(f=0; f<files; f++)
+    for(i=0; i<sides; i++) {
+        d = szItem( e, type, i, f );
+        d->blockLen = data;
+        data += 2*(U64)d->blockLenSize;
+        }
+    for(f=0; f<files; f++)
+    for(i=0; i<sides; i++) {
+        d = szItem( e, type, i, f );
+        data += (64-((data-base)&63))&63;
+        d->data = data;
+        data += (U64)d->blocks*d->blockSize;
+        }
+    return (data<=end);
+}
+
+void szFree( SzTable *e, U8 type ) {
+    U8 i;
+    SzPairs *d;
+    for(i=0; i<(type==SZ_WDL ? 8 : 4); i++) {
+        d = (type==SZ_WDL ? &e->wdl[i>>2][i&3] : &e->dtz[i]);
+        free( d->base64 ); free( d->symLen );
+        d->base64 = NULL; d->symLen = NULL;
+        }
+    UnMapFile( e->map[type], e->size[type] );
+    e->map[type] = NULL;
+}
+
+/*
+    Maps file of table at first probe, 0 if there is no valid file
+*/
+U8 szReady( SzTable *e, U8 type ) {
+
+    CONST U8 magic[2][4] = { { 0x71, 0xE8, 0x23, 0x5D }, { 0xD7, 0x66, 0x0C, 0xA5 } };
+    char path[SZ_PATH+16];
+
+    if(e->ready[type]) return (e->ready[type]==1);
+    e->ready[type] = 2;
+    if(e->dir[type]==0) return 0;
+    sprintf( path, "%s/%s%s", sz_dir[e->dir[type]-1], e->name, (type==SZ_WDL ? ".rtbw" : ".rtbz") );
+    e->map[type] = MapFile( path, &e->size[type] );
+    if(e->map[type]==NULL) return 0;
+    if(e->size[type]%64!=16 || memcmp( e->map[type], magic[type], 4 )!=0 || !szSetup( e, type )) {
+        szFree( e, type );
+        return 0;
+        }
+    e->ready[type] = 1;
+    return 1;
+}
+
+/*
+    Value at index: finds block by sparse index, then symbol in block,
+    then value in pairs of symbol
+*/
+int szDecompress( SzPairs *d, U64 idx ) {
+
+    U32 k, block;
+    int offset, len, bits, sym, l;
+    U64 buf;
+    const U8 *p;
+
+    if(d->flags & SZ_SINGLE) return d->minLen;
+
+    k = (U32)(idx/d->span);
+    if(k>=d->sparseSize) return 0;
+    block = szLE32( d->sparse+6*k );
+    offset = szLE16( d->sparse+6*k+4 ) + (int)(idx%d->span) - (int)(d->span/2);
+    if(block>=(U32)d->blockLenSize) return 0;
+    while(offset<0) {
+        if(block==0) return 0;
+        block--;
+        offset += szLE16( d->blockLen+2*block )+1;
+        }
+    while(offset>szLE16( d->blockLen+2*block )) {
+        offset -= szLE16( d->blockLen+2*block )+1;
+        if(++block>=(U32)d->blockLenSize) return 0;
+        }
+    if(block>=(U32)d->blocks) return 0;         // corrupt file
+
+    p = d->data+(U64)block*d->blockSize;
+    buf = ((U64)szBE32( p )<<32)|szBE32( p+4 );
+    p += 8;
+    bits = 64;
+    for(;;) {
+        for(len=0; buf<d->base64[len]; len++);
+        sym = (int)((buf-d->base64[len])>>(64-len-d->minLen)) + szLE16( d->lowestSym+2*len );
+        if(sym>=d->syms) return 0;
+        if(offset<d->symLen[sym]+1) break;
+        offset -= d->symLen[sym]+1;
+        len += d->minLen;
+        buf <<= len;
+        bits -= len;
+        if(bits<=32) {
+            bits += 32;
+            buf |= (U64)szBE32( p )<<(64-bits);
+            p += 4;
+            }
+        }
+    while(d->symLen[sym]) {         // left pair holds first values
+        l = szLeft( d, sym );
+        if(offset<d->symLen[l]+1) sym = l;
+        else { offset -= d->symLen[l]+1; sym = szRight( d, sym ); }
+        }
+    return szLeft( d, sym );
+}
+
+/*
+    Index of current board in table, with its data written to *dp.
+    Board is seen from the side of the table (colours swapped if needed),
+    mirrored so the leading pawn is on files a-d, or without pawns so
+    the leading piece is in a1-d1-d4 triangle.
+*/
+U64 szIndex( SzTable *e, U8 type, SzPairs **dp, U8 *file, int *res ) {
+
+    U8 sq[SZ_PIECES], pc[SZ_PIECES], s, i, j, lead = 0, size = 0, next = 0, g, flip, stm, f = 0, rp;
+    U64 idx, n, b, leadPawns = 0;
+    SzPairs *d;
+
+    // symmetric tables are stored for white to move only
+    flip = ((e->key==e->key2 && ToMove) || szBoardKey()!=e->key);
+    stm = flip^ToMove;
+
+    if(e->pawns) {
+        leadPawns = b = ((szItem( e, type, 0, 0 )->pieces[0]^(flip<<3))&8 ? BP : WP);
+        for(; b; b&=b-1) sq[size++] = trail0(b)^(flip*56);
+        if((lead = size)==0) { *res = SZ_FAIL; return 0; }
+        for(i=1, j=0; i<lead; i++) if(sz_mapPawns[sq[i]]>sz_mapPawns[sq[j]]) j = i;
+        s = sq[0]; sq[0] = sq[j]; sq[j] = s;
+        f = ((sq[0]&7)<4 ? sq[0]&7 : 7-(sq[0]&7));
+        }
+    *file = f;
+    if(type==SZ_DTZ && (szItem( e, type, 0, f )->flags & SZ_STM)!=stm && (e->key!=e->key2 || e->pawns)) {
+        *res = SZ_CHANGE_STM;
+        return 0;
+        }
+
+    for(b=(WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP)^leadPawns; b; b&=b-1) {
+        s = trail0(b);
+        j = PieceAt( s );
+        sq[size] = s^(flip*56);
+        pc[size++] = (sz_code[j&7]|(j&8))^(flip<<3);
+        }
+
+    *dp = d = szItem( e, type, stm, f );
+    for(i=lead; i+1<size; i++)      // order of pieces in table
+    for(j=i+1; j<size; j++) {
+        if(d->pieces[i]==pc[j]) {
+            s = pc[i]; pc[i] = pc[j]; pc[j] = s;
+            s = sq[i]; sq[i] = sq[j]; sq[j] = s;
+            break;
+            }
+        }
+    if((sq[0]&7)>3) for(i=0; i<size; i++) sq[i] ^= 7;
+
+    if(e->pawns) {
+        idx = sz_leadIdx[lead][sq[0]];
+        for(i=2; i<lead; i++)       // others by ascending map
+        for(j=i; j>1 && sz_mapPawns[sq[j-1]]>sz_mapPawns[sq[j]]; j--) { s = sq[j]; sq[j] = sq[j-1]; sq[j-1] = s; }
+        for(i=1; i<lead; i++) idx += sz_binom[i][sz_mapPawns[sq[i]]];
+        }
+    else {
+        if((sq[0]>>3)>3) for(i=0; i<size; i++) sq[i] ^= 56;
+        for(i=0; i<d->groupLen[0]; i++) {   // first piece off diagonal below it
+            if(szOff(sq[i])==0) continue;
+            if(szOff(sq[i])>0) for(j=i; j<size; j++) sq[j] = ((sq[j]>>3)|(sq[j]<<3))&63;
+            break;
+            }
+        if(e->unique) {
+            i = (sq[1]>sq[0]);
+            j = (sq[2]>sq[0]) + (sq[2]>sq[1]);
+            if(szOff(sq[0]))
+                idx = ((U64)sz_mapA1D1D4[sq[0]]*63 + (sq[1]-i))*62 + sq[2]-j;
+            else if(szOff(sq[1]))
+                idx = ((U64)6*63 + (sq[0]>>3)*28 + sz_mapB1H1H7[sq[1]])*62 + sq[2]-j;
+            else if(szOff(sq[2]))
+                idx = 6*63*62 + 4*28*62 + (sq[0]>>3)*7*28 + ((sq[1]>>3)-i)*28 + sz_mapB1H1H7[sq[2]];
+            else
+                idx = 6*63*62 + 4*28*62 + 4*7*28 + (sq[0]>>3)*7*6 + ((sq[1]>>3)-i)*6 + (sq[2]>>3)-j;
+            }
+        else idx = sz_mapKK[sz_mapA1D1D4[sq[0]]][sq[1]];
+        }
+
+    // other groups as combinations of squares left by previous groups
+    idx *= d->groupIdx[0];
+    rp = (e->pawns && e->pawnCnt[1]);
+    for(g=d->groupLen[0]; d->groupLen[++next]; g+=d->groupLen[next]) {
+        for(i=g+1; i<g+d->groupLen[next]; i++)
+        for(j=i; j>g && sq[j-1]>sq[j]; j--) { s = sq[j]; sq[j] = sq[j-1]; sq[j-1] = s; }
+        for(i=0, n=0; i<d->groupLen[next]; i++) {
+            for(j=0, s=0; j<g; j++) s += (sq[g+i]>sq[j]);
+            n += sz_binom[i+1][sq[g+i]-s-(rp<<3)];
+            }
+        rp = 0;
+        idx += n*d->groupIdx[next];
+        }
+    return idx;
+}
+
+/*
+    Value of table for current board: WDL, or DTZ in plies of known WDL
+*/
+int szProbe( U8 type, int wdl, int *res ) {
+
+    SzTable *e;
+    SzPairs *d;
+    U64 idx;
+    U8 f, fl;
+    int v;
+
+    if(tbPieces()==2) return 0;
+    e = szFind( szBoardKey() );
+    if(e==NULL || !szReady( e, type )) { *res = SZ_FAIL; return 0; }
+    idx = szIndex( e, type, &d, &f, res );
+    if(*res==SZ_CHANGE_STM) return 0;
+    v = szDecompress( d, idx );
+    if(type==SZ_WDL) return v-2;
+
+    fl = d->flags;
+    if(fl & SZ_MAPPED) {
+        idx = d->mapIdx[sz_wdlMap[wdl+2]] + v;
+        v = ((fl & SZ_WIDE) ? szLE16( e->dtzMap+2*idx ) : e->dtzMap[idx]);
+        }
+    if((wdl==2 && !(fl & SZ_WINPLIES)) || (wdl==-2 && !(fl & SZ_LOSSPLIES)) || wdl==1 || wdl==-1) v *= 2;
+    return v+1;
+}
+
+void szMoveGen( U8 *list ) {
+    U8 nf = mg_noflags;
+    mg_noflags = 1;
+    MoveGen( list );
+    mg_noflags = nf;
+}
+
+/*
+    WDL by tables, with captures (and pawn moves if zeroing) searched:
+    tables store "don't care" values where such a move is best.
+*/
+int szSearch( U8 zeroing, int *res ) {
+
+    U8 list[4<<8], *p;
+    int i, n, v, best = -2, moves = 0, all;
+
+    szMoveGen( list );
+    n = list[0];
+    for(i=0, p=list+1; i<n; i++, p+=4) {
+        if(!(p[3]&1) && (!zeroing || (p[0]&7)!=4)) continue;
+        moves++;
+        DoMove( p );
+        v = -szSearch( 0, res );
+        UnDoMove();
+        if(*res==SZ_FAIL) return 0;
+        if(v>best) {
+            best = v;
+            if(v>=2) { *res = SZ_ZEROING; return v; }
+            }
+        }
+    all = (moves && moves==n);
+    if(all) v = best;
+    else {
+        v = szProbe( SZ_WDL, 0, res );
+        if(*res==SZ_FAIL) return 0;
+        }
+    if(best>=v) { *res = (best>0 || all ? SZ_ZEROING : SZ_OK); return best; }
+    *res = SZ_OK;
+    return v;
+}
+
+int szBeforeZeroing( int wdl ) {
+    CONST int dtz[5] = { -1, -101, 0, 101, 1 };
+    return dtz[wdl+2];
+}
+
+/*
+    DTZ in plies, +win -loss, 0 draw. Tables store one side only,
+    for the other side it is the best of the moves.
+*/
+int szDTZ( int *res ) {
+
+    U8 list[4<<8], reply[4<<8], *p;
+    int i, n, wdl, v, zero, best = 0xFFFF;
+
+    *res = SZ_OK;
+    wdl = szSearch( 1, res );
+    if(*res==SZ_FAIL || wdl==0) return 0;
+    if(*res==SZ_ZEROING) return szBeforeZeroing( wdl );
+    v = szProbe( SZ_DTZ, wdl, res );
+    if(*res==SZ_FAIL) return 0;
+    if(*res!=SZ_CHANGE_STM) return (v + 100*(wdl==1 || wdl==-1))*szSign(wdl);
+
+    szMoveGen( list );
+    n = list[0];
+    for(i=0, p=list+1; i<n; i++, p+=4) {
+        zero = ((p[3]&1) || (p[0]&7)==4);
+        DoMove( p );
+        v = (zero ? -szBeforeZeroing( szSearch( 0, res ) ) : -szDTZ( res ));
+        if(v==1 && IsCheckNow() && (szMoveGen( reply ), reply[0]==0)) best = 1;
+        if(!zero) v += szSign(v);
+        if(v<best && szSign(v)==szSign(wdl)) best = v;
+        UnDoMove();
+        if(*res==SZ_FAIL) return 0;
+        }
+    return (best==0xFFFF ? -1 : best);
+}
+
+int SyzygyProbeWDL() {
+    int res = SZ_OK, v;
+    if(CASTLES || tbPieces()>sz_maxpcs) return TB_NONE;
+    v = szSearch( 0, &res );
+    return (res==SZ_FAIL ? TB_NONE : v);
+}
+
+int SyzygyProbeDTZ() {
+    int res = SZ_OK, v;
+    if(CASTLES || tbPieces()>sz_maxpcs) return TB_NONE;
+    v = szDTZ( &res );
+    return (res==SZ_FAIL ? TB_NONE : v);
+}
+
+void szScanDir( U8 di ) {
+#ifdef _WIN32
+    struct _finddata_t fd;
+    intptr_t h;
+    char pat[SZ_PATH+16];
+    sprintf( pat, "%s\\*.rtb?", sz_dir[di] );
+    if((h = _findfirst( pat, &fd ))==-1) return;
+    do szAddFile( fd.name, di ); while(_findnext( h, &fd )==0);
+    _findclose( h );
+#else
+    DIR *dir = opendir( sz_dir[di] );
+    struct dirent *de;
+    if(dir==NULL) return;
+    while((de = readdir( dir ))!=NULL) szAddFile( de->d_name, di );
+    closedir( dir );
+#endif
+}
+
+/*
+    Finds Syzygy files in directories separated by ':' (';' on Windows),
+    replacing tables of previous call. Files are mapped when probed.
+    Returns count of WDL tables.
+*/
+int SyzygyInit( char *paths ) {
+
+#ifdef _WIN32
+    const char sep = ';';
+#else
+    const char sep = ':';
+#endif
+    char *c;
+    int i, n = 0, len;
+
+    szInit();
+    for(i=0; i<sz_cnt; i++) { szFree( &sz_tab[i], SZ_WDL ); szFree( &sz_tab[i], SZ_DTZ ); }
+    free( sz_tab ); free( sz_hash );
+    sz_tab = NULL; sz_hash = NULL;
+    sz_cnt = sz_hsize = 0;
+    sz_dirs = sz_maxpcs = 0;
+
+    while(*paths && sz_dirs<SZ_DIRS) {
+        c = strchr( paths, sep );
+        len = (c==NULL ? (int)strlen( paths ) : (int)(c-paths));
+        if(len>0 && len<SZ_PATH) {
+            memcpy( sz_dir[sz_dirs], paths, len );
+            sz_dir[sz_dirs][len] = 0;
+            szScanDir( sz_dirs++ );
+            }
+        paths += len + (c!=NULL);
+        }
+
+    for(sz_hsize=64; sz_hsize<4*sz_cnt; sz_hsize<<=1);
+    sz_hash = (int *)calloc( sz_hsize, sizeof(int) );
+    if(sz_hash==NULL) { sz_hsize = 0; return 0; }
+    for(i=0; i<sz_cnt; i++) {
+        szHashAdd( sz_tab[i].key, i );
+        if(sz_tab[i].key2!=sz_tab[i].key) szHashAdd( sz_tab[i].key2, i );
+        if(sz_tab[i].dir[SZ_WDL]) {
+            n++;
+            if(sz_tab[i].pcs>sz_maxpcs) sz_maxpcs = sz_tab[i].pcs;
+            }
+        }
+    if(n && !sz_registered) sz_registered = TbRegister( SyzygyProbeWDL, SyzygyProbeDTZ, SZ_PIECES );
+    return n;
+}
+
+#endif  /* _INC_u64_EGTB */
@@ -0,0 +1,422 @@
+/*
+ ---------------------------------------------
+
+    u64_mcts  PUCT tree search for u64_chess
+
+    Nodes are in one pool (arena), children of a node are next
+    to each other. Leaves are collected into batches: virtual
+    loss on the path makes next descents choose other leaves,
+    then one call of eval gives policy and value of all leaves
+    of the batch, as a neural net does.
+    Leaves of a batch can be collected by forked workers, each on
+    own copy of the board: the pool is in shared memory, virtual
+    losses and new leaves are taken by atomic ops. Eval and backup
+    are done here, while workers wait for next batch.
+
+    Features of leaf: MCTS_PLANES planes of 64 floats (a1..h8),
+    pieces WQ,WR,WB,WN,WP,WK,BQ,BR,BB,BN,BP,BK, castling rooks
+    and kings, en-passant square, ones if black to move.
+    Policy: MCTS_POLICY floats, any scale >=0, normalised over legal
+    moves: from*64+to, queen promotions too, then underpromotions at
+    4096 + (from file*3 + to file-from file+1)*3 + 0-R,1-B,2-N.
+    Value: -1..1 for side to move at leaf.
+
+---------------------------------------------
+*/
+
+#ifndef _INC_u64_MCTS
+#define _INC_u64_MCTS
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#endif
+
+#include "u64_chess.h"
+#include "u64_egtb.h"
+#include "u64_search.h"
+
+#define MCTS_PLANES 15
+#define MCTS_POLICY (4096+8*3*3)
+#define MCTS_DEPTH 512
+#define MCTS_BATCH 256
+#define MCTS_WORKERS 64
+
+#define MCTS_NEW 0
+#define MCTS_PENDING 1      // in batch, waiting for eval
+#define MCTS_EXPANDED 2
+#define MCTS_TERMINAL 3
+#define MCTS_CLAIMED 4      // being expanded by a worker
+
+#ifndef _WIN32
+#define mctsAdd(p,v) __sync_fetch_and_add( (p), (v) )
+#define mctsClaim(p) __sync_bool_compare_and_swap( (p), MCTS_NEW, MCTS_CLAIMED )
+#else                       // no workers
+#define mctsAdd(p,v) ((*(p) += (v)) - (v))
+#define mctsClaim(p) (*(p)==MCTS_NEW ? (*(p) = MCTS_CLAIMED, 1) : 0)
+#endif
+
+typedef struct {
+    U8 mv[4];
+    float prior;
+    float w;            // sum of values for side that made the move
+    int n;              // visits
+    int vl;             // virtual losses of descents in batch
+    int child;          // first child in pool
+    U16 nchild;
+    U8 state;
+    float term;         // value of terminal for side to move
+} MctsNode;
+
+// returns 0 on error, policy[n*MCTS_POLICY], value[n]
+typedef int (*MctsEval)( void *arg, float *planes, int n, float *policy, float *value );
+
+typedef struct {
+    MctsNode *nodes;
+    int size, used;
+    float cpuct;
+    int *alloc;         // shared count of used nodes while workers run
+} Mcts;
+
+// leaves of batch, shared with workers
+typedef struct {
+    int used;
+    int lens[MCTS_BATCH];
+    int paths[MCTS_BATCH*MCTS_DEPTH];
+    float planes[MCTS_BATCH*MCTS_PLANES*64];
+} MctsBuf;
+
+// memory seen by forked workers too
+void *mctsShared( size_t size ) {
+#ifndef _WIN32
+    void *p = mmap( NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0 );
+    return (p==MAP_FAILED ? NULL : p);
+#else
+    return malloc( size );
+#endif
+}
+
+void mctsUnshare( void *p, size_t size ) {
+    if(p==NULL) return;
+#ifndef _WIN32
+    munmap( p, size );
+#else
+    free( p );
+#endif
+}
+
+U8 MctsInit( Mcts *t, int size, float cpuct ) {
+    t->size = (size>1 ? size : 2);
+    t->nodes = (MctsNode *)mctsShared( t->size*sizeof(MctsNode) );
+    if(t->nodes==NULL) return 0;
+    t->used = 1;
+    t->cpuct = cpuct;
+    t->alloc = NULL;
+    memset( t->nodes, 0, sizeof(MctsNode) );
+    return 1;
+}
+
+void MctsFree( Mcts *t ) {
+    mctsUnshare( t->nodes, t->size*sizeof(MctsNode) );
+    t->nodes = NULL;
+}
+
+void mctsPlanes( float *f ) {
+
+    U8 j, k = 0;
+    U64 o;
+
+    memset( f, 0, MCTS_PLANES*64*sizeof(float) );
+    for(j=0; j<14; j++, k++) {
+        if(j==6) j = 8;
+        for(o=*PIECES[j]; o; o&=o-1) f[(k<<6)+trail0(o)] = 1.0f;
+        }
+    for(o=CASTLES; o; o&=o-1) f[(12<<6)+trail0(o)] = 1.0f;
+    if(ENPSQ) f[(13<<6)+trail0(ENPSQ)] = 1.0f;
+    if(ToMove) for(j=0; j<64; j++) f[(14<<6)+j] = 1.0f;
+}
+
+// index of move in policy
+int MctsPolicyIndex( U8 *mv ) {
+    U8 pc = (mv[3]>>2)&3;
+    if(!(mv[3]&2) || pc==0) return ((mv[1]<<6)+mv[2]);
+    return 4096 + ((mv[1]&7)*3 + (mv[2]&7)-(mv[1]&7)+1)*3 + pc-1;
+}
+
+/*
+    Children of node by MoveGen, or terminal value.
+    Returns 0 if pool is full.
+*/
+U8 mctsExpand( Mcts *t, MctsNode *d ) {
+
+    U8 list[4<<8], *p, i, cnt;
+    int w, first;
+    MctsNode *c;
+
+    mg_noflags = 1;
+    MoveGen( list );
+    mg_noflags = 0;
+    cnt = list[0];
+    if(cnt==0) {
+        d->state = MCTS_TERMINAL;
+        d->term = (IsCheckNow() ? -1.0f : 0.0f);
+        return 1;
+        }
+    if(InsufficientMaterial() || Repetitions()>=3 || HalfMoves>=100) {
+        d->state = MCTS_TERMINAL;
+        d->term = 0.0f;
+        return 1;
+        }
+    if((w = TbProbeWDL())!=TB_NONE) {
+        d->state = MCTS_TERMINAL;
+        d->term = (w>TB_BLESSED_LOSS ? (w<TB_CURSED_WIN ? 0.0f : 1.0f) : -1.0f);
+        return 1;
+        }
+    first = (t->alloc!=NULL ? mctsAdd( t->alloc, cnt ) : t->used);
+    if(first+cnt>t->size) return 0;
+    if(t->alloc==NULL) t->used += cnt;
+
+    d->child = first;
+    d->nchild = cnt;
+    for(i=0, p=list+1; i<cnt; i++, p+=4) {
+        c = &t->nodes[d->child+i];
+        memset( c, 0, sizeof(MctsNode) );
+        memcpy( c->mv, p, 4 );
+        c->prior = 1.0f/cnt;
+        }
+    d->state = MCTS_PENDING;
+    return 1;
+}
+
+// PUCT choice, virtual losses count as lost visits
+MctsNode *mctsSelect( Mcts *t, MctsNode *d ) {
+
+    MctsNode *c = &t->nodes[d->child], *best = c;
+    float sq = sqrtf( (float)(d->n+d->vl+1) ), s, bs = -1e30f;
+    int i, m;
+
+    for(i=0; i<d->nchild; i++, c++) {
+        m = c->n + c->vl;
+        s = (m ? (c->w - c->vl)/m : 0.0f) + t->cpuct*c->prior*sq/(1+m);
+        if(s>bs) { bs = s; best = c; }
+        }
+    return best;
+}
+
+void mctsBackup( Mcts *t, int *path, int len, float v, U8 vl ) {
+
+    MctsNode *d;
+    while(len-->0) {
+        d = &t->nodes[path[len]];
+        d->n++;
+        d->w -= v;          // for side that moved into
+        if(vl) d->vl--;
+        v = -v;
+        }
+}
+
+/*
+    Descents from root into up to q leaves, virtual loss on each path.
+    New leaves get planes, terminals are kept for backup too.
+    Returns count of leaves, *stop=1 if pool is full.
+*/
+int mctsCollect( Mcts *t, int q, int *paths, int *lens, float *planes, int deep, U8 *stop ) {
+
+    int b, k, len, miss = 0;
+    U8 mine;
+    MctsNode *d, *c;
+    U64 *undo = undo_p;
+
+    for(b=0; b<q && miss<q && !*stop; ) {
+
+        int *path = paths+b*MCTS_DEPTH;
+        d = t->nodes;
+        len = 0;
+        path[len++] = 0;
+        mctsAdd( &d->vl, 1 );
+        while(d->state==MCTS_EXPANDED && len<deep) {
+            c = mctsSelect( t, d );
+            DoMove( c->mv );
+            d = c;
+            path[len++] = (int)(d-t->nodes);
+            mctsAdd( &d->vl, 1 );
+            }
+        mine = (d->state==MCTS_NEW && mctsClaim( &d->state ));
+        if(mine && !mctsExpand( t, d )) {
+            d->state = MCTS_NEW;
+            *stop = 1;
+            }
+
+        if(d->state==MCTS_TERMINAL) lens[b++] = len;
+        else if(d->state==MCTS_PENDING && mine) {
+            mctsPlanes( planes+b*MCTS_PLANES*64 );
+            lens[b++] = len;
+            }
+        else {
+            for(k=0; k<len; k++) mctsAdd( &t->nodes[path[k]].vl, -1 );
+            if(d->state==MCTS_NEW || d->state==MCTS_EXPANDED) miss = q;   // full pool or too deep
+            else miss++;                // already in this batch
+            }
+        while(undo_p>undo) UnDoMove();
+        }
+    return b;
+}
+
+#ifndef _WIN32
+// forked worker, collects leaves on requests {count, first slot}
+void mctsWorker( Mcts *t, MctsBuf *m, int deep, int rfd, int wfd ) {
+
+    int req[2], rep[2];
+    U8 stop;
+
+    while(read( rfd, req, sizeof(req) )==sizeof(req) && req[0]>0) {
+        stop = 0;
+        rep[0] = mctsCollect( t, req[0], m->paths+req[1]*MCTS_DEPTH, m->lens+req[1],
+            m->planes+req[1]*MCTS_PLANES*64, deep, &stop );
+        rep[1] = stop;
+        if(write( wfd, rep, sizeof(rep) )!=sizeof(rep)) break;
+        }
+    _exit(0);
+}
+#endif
+
+/*
+    Runs sims descents from current position, batch leaves per eval call.
+    Forks workers (0-count of cpus, 1-none) to collect leaves of batch.
+    Board is restored. Returns count of descents, -1 if eval failed,
+    -2 if eval left the board at other undo level.
+*/
+int MctsSearch( Mcts *t, int sims, int batch, int workers, MctsEval eval, void *arg ) {
+
+    int idx[MCTS_BATCH], base[MCTS_WORKERS], got[MCTS_WORKERS];
+    int i, k, s, b, n, q, nw = 0, done = 0, deep;
+    float *policy, *value, sum;
+    U8 stop = 0;
+    MctsNode *d, *c;
+    MctsBuf *m;
+    U64 *undo = undo_p;
+#ifndef _WIN32
+    int req[MCTS_WORKERS][2], rep[MCTS_WORKERS][2], msg[2], st;
+    pid_t pid[MCTS_WORKERS];
+#endif
+
+    if(batch<1) batch = 1;
+    if(batch>MCTS_BATCH) batch = MCTS_BATCH;
+    deep = (int)((undobuffer+UNDO_REC*UNDO_PLIES-undo_p)/UNDO_REC) - 1;     // room in undo buffer
+    if(deep>MCTS_DEPTH) deep = MCTS_DEPTH;
+    m = (MctsBuf *)mctsShared( sizeof(MctsBuf) );
+    policy = (float *)malloc( batch*MCTS_POLICY*sizeof(float) );
+    value = (float *)malloc( batch*sizeof(float) );
+    if(m==NULL || policy==NULL || value==NULL) {
+        mctsUnshare( m, sizeof(MctsBuf) ); free( policy ); free( value );
+        return -1;
+        }
+
+#ifndef _WIN32
+    if(workers<=0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(workers>MCTS_WORKERS) workers = MCTS_WORKERS;
+    if(workers>batch) workers = batch;
+    m->used = t->used;
+    if(workers>1) t->alloc = &m->used;
+    for(nw=0; workers>1 && nw<workers; nw++) {
+        if(pipe( req[nw] )!=0) break;
+        if(pipe( rep[nw] )!=0) { close( req[nw][0] ); close( req[nw][1] ); break; }
+        fflush(NULL);
+        pid[nw] = fork();
+        if(pid[nw]==0) {
+            for(i=0; i<nw; i++) { close( req[i][1] ); close( rep[i][0] ); }
+            close( req[nw][1] ); close( rep[nw][0] );
+            mctsWorker( t, m, deep, req[nw][0], rep[nw][1] );
+            }
+        close( req[nw][0] ); close( rep[nw][1] );
+        if(pid[nw]<0) { close( req[nw][1] ); close( rep[nw][0] ); break; }
+        }
+    if(nw==0) t->alloc = NULL;      // here, if could not fork
+#endif
+
+    while(done<sims && !stop) {
+
+        q = (sims-done<batch ? sims-done : batch);
+        base[0] = 0;
+        got[0] = 0;
+#ifndef _WIN32
+        for(i=0; i<nw; i++) {
+            msg[0] = q/nw + (i<q%nw ? 1 : 0);
+            msg[1] = base[i] = (i ? base[i-1]+got[i-1] : 0);
+            got[i] = msg[0];
+            if(msg[0] && write( req[i][1], msg, sizeof(msg) )!=sizeof(msg)) got[i] = 0, stop = 1;
+            }
+        for(i=0; i<nw; i++) {
+            if(got[i]==0) continue;
+            got[i] = 0;
+            if(read( rep[i][0], msg, sizeof(msg) )!=sizeof(msg)) { stop = 1; continue; }   // worker lost
+            got[i] = msg[0];
+            if(msg[1]) stop = 1;
+            }
+#endif
+        if(nw==0) got[0] = mctsCollect( t, q, m->paths, m->lens, m->planes, deep, &stop );
+
+        // terminals backed up now, planes of new leaves moved together
+        for(i=0, b=0, n=0; i<(nw ? nw : 1); i++) {
+            for(s=base[i]; s<base[i]+got[i]; s++, n++) {
+                d = &t->nodes[m->paths[s*MCTS_DEPTH+m->lens[s]-1]];
+                if(d->state==MCTS_TERMINAL) {
+                    mctsBackup( t, m->paths+s*MCTS_DEPTH, m->lens[s], d->term, 1 );
+                    done++;
+                    continue;
+                    }
+                if(s>b) memmove( m->planes+b*MCTS_PLANES*64, m->planes+s*MCTS_PLANES*64, MCTS_PLANES*64*sizeof(float) );
+                idx[b++] = s;
+                }
+            }
+        if(n==0) break;         // nothing to do more
+        if(b==0) continue;
+
+        if(!eval( arg, m->planes, b, policy, value ) || undo_p!=undo) {
+            for(i=0; i<b; i++) {
+                for(k=0; k<m->lens[idx[i]]; k++) t->nodes[m->paths[idx[i]*MCTS_DEPTH+k]].vl--;
+                }
+            done = (undo_p!=undo ? -2 : -1);
+            break;
+            }
+
+        for(i=0; i<b; i++) {
+            s = idx[i];
+            d = &t->nodes[m->paths[s*MCTS_DEPTH+m->lens[s]-1]];
+            c = &t->nodes[d->child];
+            for(k=0, sum=0.0f; k<d->nchild; k++) {
+                c[k].prior = policy[i*MCTS_POLICY+MctsPolicyIndex( c[k].mv )];
+                if(!(c[k].prior>0.0f)) c[k].prior = 0.0f;       // NaN too
+                sum += c[k].prior;
+                }
+            for(k=0; k<d->nchild; k++) {
+                c[k].prior = (sum>0.0f ? c[k].prior/sum : 1.0f/d->nchild);
+                }
+            d->state = MCTS_EXPANDED;
+            mctsBackup( t, m->paths+s*MCTS_DEPTH, m->lens[s], value[i], 1 );
+            done++;
+            }
+        }
+
+#ifndef _WIN32
+    for(i=0; i<nw; i++) {           // end of requests ends worker
+        close( req[i][1] ); close( rep[i][0] );
+        waitpid( pid[i], &st, 0 );
+        }
+    if(nw) {
+        t->used = (m->used<t->size ? m->used : t->size);
+        t->alloc = NULL;
+        }
+#endif
+    mctsUnshare( m, sizeof(MctsBuf) );
+    free( policy ); free( value );
+    return done;
+}
+
+#endif  /* _INC_u64_MCTS */
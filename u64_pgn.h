@@ -0,0 +1,1123 @@
+/*
+ ---------------------------------------------
+
+    u64_pgn  PGN for u64_chess
+
+    Parses PGN movetext into uci moves on board,
+    tokens with variations, NAGs and comments.
+    Compact game files, one byte per move.
+    Reads large PGN files by blocks, splits games,
+    gets tags and movetext of each game.
+    Memory is bounded by reader buffers, for any size of file.
+
+---------------------------------------------
+*/
+
+#ifndef _INC_u64_PGN
+#define _INC_u64_PGN
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "u64_chess.h"
+
+#ifdef _WIN32
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#endif
+
+//------------------------------------------
+//
+//	SAN move resolver, no MoveGen.
+//  Finds which piece can reach the square by reverse attack lookups,
+//  verifies king safety of the candidate only, and makes the move.
+//
+
+/*
+    Castling, if possible, fcastle 1-short, 2-long
+*/
+U8 pgnCastle( int fcastle, char *uci ) {
+
+    U8 k = (ToMove ? 60 : 4), t = (fcastle==1 ? k+2 : k-2), mv[4];
+
+    if(!CanCastle( t )) return 0;
+    uci[0] = 'e'; uci[1] = uci[3] = (ToMove ? '8' : '1');
+    uci[2] = (fcastle==1 ? 'g' : 'c'); uci[4] = 0;
+    uciToMv( uci, mv );
+    DoMove( mv );
+    return 1;
+}
+
+/*
+    Resolves SAN parts and makes the move on board.
+        Pc - piece "QRBNPK" or 0 for pawn,
+        h1,v1 - from file,rank if given, h2,v2 - to square,
+        Pp - promotion piece "qrbn" or 0,
+    uci gets the move, returns 1 if made, 0 if can not.
+*/
+U8 SanMove( char Pc, char h1, char v1, char h2, char v2, char Pp, char *uci ) {
+
+    U64 occ = WK|WQ|WR|WB|WN|WP|BK|BQ|BR|BB|BN|BP;
+    U64 own = (ToMove ? BK|BQ|BR|BB|BN|BP : WK|WQ|WR|WB|WN|WP);
+    U64 T = ~own, F = ~0LL, P, c, o;
+    U8 ty, to, fr, mv[4];
+    const char *pcs = "QRBNPK";
+
+    if(h2) T &= (FILE_A<<(h2-'a'));
+    if(v2) T &= (255LL<<((v2-'1')<<3));
+    if(h1) F &= (FILE_A<<(h1-'a'));
+    if(v1) F &= (255LL<<((v1-'1')<<3));
+
+    if(Pc==0 || Pc=='P') ty = 4;
+    else ty = (U8)(strchr( pcs, Pc ) - pcs);
+    if(Pc==0 && h1 && v1 && ((F & own) & ~(ToMove ? BP : WP))) ty = PieceAt( trail0(F) ) & 7;   // e.g. "g1f3"
+    P = *(PIECES[ty + (ToMove<<3)]) & F;
+
+    for(; T; T&=T-1) {
+        to = trail0(T);
+        switch(ty) {
+            case 0: c = (getRookMove(to,occ) | getBishopMove(to,occ)) & P; break;
+            case 1: c = getRookMove(to,occ) & P; break;
+            case 2: c = getBishopMove(to,occ) & P; break;
+            case 3: c = KnightLegals[to] & P; break;
+            case 5: c = KingLegals[to] & P; break;
+            default:
+                o = (1LL<<to);
+                if(ToMove) {
+                    if((occ|ENPSQ) & o) c = PawnBlackAtck[to] & P;
+                    else {
+                        c = (o<<8) & P;
+                        if(!c && to>31 && to<40 && !(occ & (o<<8))) c = (o<<16) & P;
+                        }
+                    }
+                else {
+                    if((occ|ENPSQ) & o) c = PawnWhiteAtck[to] & P;
+                    else {
+                        c = (o>>8) & P;
+                        if(!c && to>23 && to<32 && !(occ & (o>>8))) c = (o>>16) & P;
+                        }
+                    }
+            }
+        for(; c; c&=c-1) {
+            fr = trail0(c);
+            uci[0] = (fr&7)+'a'; uci[1] = (fr>>3)+'1';
+            uci[2] = (to&7)+'a'; uci[3] = (to>>3)+'1';
+            uci[4] = 0;
+            if(ty==4 && (to<8 || to>55)) {
+                uci[4] = (Pp ? Pp : 'q');
+                uci[5] = 0;
+                }
+            if(!uciToMv( uci, mv )) continue;
+            DoMove( mv );
+            if(!MoverInCheck()) return 1;
+            UnDoMove();
+            }
+        }
+    return 0;
+}
+
+//------------------------------------------
+//
+//	PGN movetext tokenizer.
+//  Tokens are slices of the text, it is not copied nor modified.
+//
+
+#define PGN_TK_END      0
+#define PGN_TK_MOVE     1       // SAN (or uci) move
+#define PGN_TK_NUMBER   2       // move number "12." "12..."
+#define PGN_TK_COMMENT  3       // {...} or ;... up to end of line, without delimiters
+#define PGN_TK_NAG      4       // $n or !? suffixes
+#define PGN_TK_VAR      5       // (
+#define PGN_TK_VAREND   6       // )
+#define PGN_TK_RESULT   7       // 1-0 0-1 1/2-1/2 *
+
+typedef struct {
+    U8 kind;
+    const char *s;              // not 0-terminated
+    int len;
+} PgnTok;
+
+/*
+    Reads token at s into t, returns position after it
+*/
+const char *PgnToken( const char *s, PgnTok *t ) {
+
+    const char *e;
+    int q;
+
+    for(;;) {
+        while(*s!=0 && (U8)(*s)<=' ') s++;
+        t->s = s;
+        t->len = 0;
+        switch(*s) {
+            case 0:
+                t->kind = PGN_TK_END;
+                return s;
+            case '{':
+                for(q=1, s++; *s!=0 && q>0; s++) {
+                    if(*s=='{') q++;
+                    else if(*s=='}') q--;
+                    }
+                t->kind = PGN_TK_COMMENT;
+                t->s++;
+                t->len = (int)(s-t->s) - (q==0 ? 1 : 0);
+                return s;
+            case ';':
+                while(*s!=0 && *s!=10 && *s!=13) s++;
+                t->kind = PGN_TK_COMMENT;
+                t->s++;
+                t->len = (int)(s-t->s);
+                return s;
+            case '%':       // escape line
+                while(*s!=0 && *s!=10) s++;
+                continue;
+            case '}':
+                s++;
+                continue;
+            case '(':
+            case ')':
+                t->kind = (*s=='(' ? PGN_TK_VAR : PGN_TK_VAREND);
+                t->len = 1;
+                return s+1;
+            case '*':
+                t->kind = PGN_TK_RESULT;
+                t->len = 1;
+                return s+1;
+            case '$':
+                for(s++; *s>='0' && *s<='9'; s++);
+                t->kind = PGN_TK_NAG;
+                t->len = (int)(s-t->s);
+                return s;
+            case '!':
+            case '?':
+                while(*s=='!' || *s=='?') s++;
+                t->kind = PGN_TK_NAG;
+                t->len = (int)(s-t->s);
+                return s;
+            }
+
+        for(e=s; *e>='0' && *e<='9'; e++);
+        if(e>s && (*e=='.' || (U8)(*e)<=' ')) {
+            while(*e=='.') e++;
+            t->kind = PGN_TK_NUMBER;
+            t->len = (int)(e-s);
+            return e;
+            }
+        for(e=s; (U8)(*e)>' ' && strchr( "{}();$!?", *e )==NULL; e++);
+        t->len = (int)(e-s);
+        if((t->len==3 && (strncmp(s,"1-0",3)==0 || strncmp(s,"0-1",3)==0)) ||
+            (t->len==7 && strncmp(s,"1/2-1/2",7)==0)) {
+            t->kind = PGN_TK_RESULT;
+            return e;
+            }
+        if((t->len==4 && strncmp(s,"e.p.",4)==0) || (t->len==2 && strncmp(s,"ep",2)==0)) {
+            s = e;
+            continue;
+            }
+        t->kind = PGN_TK_MOVE;
+        return e;
+        }
+}
+
+/*
+    Makes move of SAN token on board, uci gets the move.
+    Returns 1 if made, 0 if can not.
+*/
+U8 PgnSanToken( const char *s, int len, char *uci ) {
+
+    const char *e = s+len;
+    char Pc=0, Pp=0;
+    int w=0;
+    char *P;
+    char c, h1=0,v1=0,h2=0,v2=0;
+
+    if(len>=5 && ((strncmp(s,"0-0-0",5)==0)||(strncmp(s,"O-O-O",5)==0))) return pgnCastle( 2, uci );
+    if(len>=3 && ((strncmp(s,"0-0",3)==0)||(strncmp(s,"O-O",3)==0))) return pgnCastle( 1, uci );
+
+    for(; s<e; s++) {
+        c = *s;
+        if(c=='.') w=0;
+        if(Pc==0) {
+            P = strchr("QRBNPK",c);
+            if(P!=NULL) { Pc = *P; w=1; }
+        }
+        if(w<3 && (c=='x'||c=='-'||c==':')) w=3;
+
+        if(c>='a' && c<='h') {
+            if(w<3 && h1==0) { h1=c; w=2; }
+            else if(w<6) { h2=c; w=4; }
+        }
+        if(w>0 && c>='1' && c<='8') {
+            if(w<3 && v1==0) { v1=c; w=3; }
+            else if(w<6) { v2=c; w=5; }
+        }
+        if(c=='=') {
+            w=6;
+            if(s+1==e) break;
+            c = *(++s);
+            }
+        if(w>4) {
+            P = strchr("QRBN",c);
+            if(P!=NULL) Pp = (*P)+32;
+            else {
+                P = strchr("qrbn",c);
+                if(P!=NULL) Pp = *P;
+            }
+        }
+    }
+    if(h2==0) { h2=h1; v2=v1; h1=0; v1=0; }
+    if(h2==0 && v2==0) return 0;
+
+    return SanMove( Pc, h1, v1, h2, v2, Pp, uci );
+}
+
+//------------------------------------------
+//
+//	Comment annotations [%eval ...] [%clk ...]
+//
+
+#define PGN_NOVAL (-2147483647-1)  // no annotation for this ply
+#define PGN_MATE 100000             // eval of mate in n is +-(PGN_MATE-n)
+#define PGN_PLIES 1024              // max.main line plies, as deep as undo buffer
+
+/*
+    Number at s, scaled by mul (decimals are taken too).
+    Returns position after it.
+*/
+const char *pgnNum( const char *s, const char *e, int mul, int *v ) {
+    int sg = 1, d = 0, m = mul;
+    if(s<e && (*s=='-' || *s=='+')) { if(*s=='-') sg = -1; s++; }
+    for(; s<e && *s>='0' && *s<='9'; s++) d = (d*10) + (*s-'0');
+    d *= mul;
+    if(s<e && *s=='.') {
+        for(s++; s<e && *s>='0' && *s<='9'; s++) {
+            m /= 10;
+            d += (*s-'0')*m;
+            }
+        }
+    *v = sg*d;
+    return s;
+}
+
+/*
+    Gets eval (centipawns, from white side) and clock (milliseconds)
+    of comment, leaves them as they are if not found.
+*/
+void PgnCommentAnnot( const char *s, int len, int *eval, int *clk ) {
+
+    const char *e = s+len;
+    int v, h;
+
+    for(; s<e; s++) {
+        s = (const char *)memchr( s, '%', e-s );
+        if(s==NULL) return;
+        if(e-s>5 && strncmp(s,"%eval",5)==0) {
+            for(s+=5; s<e && *s==' '; s++);
+            if(s<e && *s=='#') {
+                pgnNum( s+1, e, 1, &v );
+                *eval = (v<0 ? -PGN_MATE-v : PGN_MATE-v);
+                }
+            else if(s<e && (*s=='-' || *s=='+' || (*s>='0' && *s<='9'))) {
+                pgnNum( s, e, 100, eval );
+                }
+            }
+        else if(e-s>4 && strncmp(s,"%clk",4)==0) {
+            for(s+=4; s<e && *s==' '; s++);
+            if(s>=e || *s<'0' || *s>'9') continue;
+            for(h=0;;) {        // h:mm:ss.f
+                s = pgnNum( s, e, 1000, &v );
+                h = (h*60) + v;
+                if(s>=e || *s!=':') break;
+                s++;
+                }
+            *clk = h;
+            }
+        }
+}
+
+//------------------------------------------
+//
+//	Parse PGN part
+//
+//  Variations are played too: "(" takes back the last move
+//  and plays the variation, ")" takes back the variation and
+//  redoes the move, all on the undo stack.
+//  At the end the board is at the last move of main line.
+//
+
+#define PGN_VARS 64             // max.depth of variations, deeper are skipped
+
+/*
+    Visitor of tokens, gets depth of variation (0-main line)
+    and uci of move token (NULL if could not be made)
+*/
+typedef void (*PgnVisit)( void *arg, PgnTok *t, int depth, char *uci );
+
+/*
+    Walks pgn movetext, ucis gets the main line uci moves
+    of size bytes at most, evals,clks (if not NULL) get
+    annotations of each main line ply, PGN_PLIES at most,
+    visit (if not NULL) gets each token.
+    Returns count of main line moves made on board.
+*/
+int PgnWalk( const char *pgn, char *ucis, int size, int *evals, int *clks, PgnVisit visit, void *arg ) {
+
+    PgnTok t;
+    const char *s = pgn;
+    char *u = ucis, *ue = ucis+size-8;
+    char last[PGN_VARS][8];     // last move of each depth
+    int made[PGN_VARS];         // moves made on board in variation
+    char uci[8];
+    U64 *undo_e = undobuffer + (sizeof(undobuffer)/sizeof(U64)) - 16;
+    int d = 0, skip = 0, mn = 0, dv, nv;
+    U8 mv[4], ok;
+
+    *u = 0;
+    last[0][0] = 0;
+    made[0] = 0;
+
+    for(;;) {
+        s = PgnToken( s, &t );
+        if(t.kind==PGN_TK_END) break;
+        ok = 0;
+        dv = d+skip;
+        switch(t.kind) {
+            case PGN_TK_MOVE:
+                if(skip || undo_p>=undo_e || (d==0 && (u>=ue || mn>=PGN_PLIES))) break;
+                ok = PgnSanToken( t.s, t.len, uci );
+                if(!ok) break;
+                strcpy( last[d], uci );
+                made[d]++;
+                if(d==0) {
+                    strcpy( u, uci );
+                    while(*u) u++;
+                    *(u++) = ' ';
+                    *u = 0;
+                    if(evals!=NULL) evals[mn] = PGN_NOVAL;
+                    if(clks!=NULL) clks[mn] = PGN_NOVAL;
+                    mn++;
+                    }
+                break;
+            case PGN_TK_COMMENT:
+                if(d==0 && !skip && mn>0 && (evals!=NULL || clks!=NULL)) {
+                    PgnCommentAnnot( t.s, t.len, (evals!=NULL ? evals+mn-1 : &nv),
+                        (clks!=NULL ? clks+mn-1 : &nv) );
+                    }
+                break;
+            case PGN_TK_VAR:
+                if(skip || d==PGN_VARS-1 || !made[d]) skip++;
+                else {
+                    UnDoMove();
+                    made[d]--;
+                    d++;
+                    made[d] = 0;
+                    last[d][0] = 0;
+                    }
+                dv = d+skip;
+                break;
+            case PGN_TK_VAREND:
+                if(skip) skip--;
+                else if(d>0) {
+                    while(made[d]-- > 0) UnDoMove();
+                    d--;
+                    uciToMv( last[d], mv );
+                    DoMove( mv );
+                    made[d]++;
+                    }
+                break;
+            }
+        if(visit!=NULL) visit( arg, &t, dv, (ok ? uci : NULL) );
+        }
+
+    while(d>0) {        // not closed variations
+        while(made[d]-- > 0) UnDoMove();
+        d--;
+        uciToMv( last[d], mv );
+        DoMove( mv );
+        made[d]++;
+        }
+    return mn;
+}
+
+/*
+    Main line of pgn movetext, ucis gets the uci moves
+    of size bytes at most, returns count of moves made on board.
+*/
+int parse_pgn_moves( const char *pgn, char *ucis, int size ) {
+    return PgnWalk( pgn, ucis, size, NULL, NULL, NULL, NULL );
+}
+
+
+//------------------------------------------
+//
+//	PGN file reader
+//
+
+#define PGN_BLOCK (1<<20)       // file is read by 1Mb blocks
+#define PGN_GAME (1<<18)        // max.length of game text, longer are cut
+#define PGN_TAGS 64             // max.count of tags in game
+
+typedef struct {
+    FILE *f;
+    char blk[PGN_BLOCK];        // file block
+    int bpos, blen, lnext;      // position in block, data length, next line
+    U8 eof;
+    long long foff;             // file offset of blk[0]
+    long long fend;             // games starting here or later are not read, 0-all
+
+    char game[PGN_GAME+8];      // text of current game, tags and movetext
+    int glen;
+    char *tag[PGN_TAGS];        // tag names and values, pointers into game[]
+    char *val[PGN_TAGS];
+    int ntags;
+    char *movetext;             // pointer into game[]
+
+    char ucis[PGN_GAME*2];      // uci moves of game after PgnPlayGame
+    int nmoves;
+    int eval[PGN_PLIES];        // [%eval] of each ply, or PGN_NOVAL
+    int clk[PGN_PLIES];         // [%clk] of each ply, milliseconds
+    PgnVisit visit;             // tokens of movetext go here too, if set
+    void *varg;
+    long long games;            // count of games read
+} PgnReader;
+
+U8 PgnOpen( PgnReader *r, char *path ) {
+    r->f = fopen( path, "rb" );
+    r->bpos = r->blen = r->lnext = 0;
+    r->eof = 0;
+    r->foff = r->fend = 0;
+    r->glen = r->ntags = r->nmoves = 0;
+    r->movetext = r->game;
+    r->game[0] = 0;
+    r->ucis[0] = 0;
+    r->games = 0;
+    r->visit = NULL;
+    r->varg = NULL;
+    return (r->f ? 1 : 0);
+}
+
+void PgnClose( PgnReader *r ) {
+    if(r->f) fclose(r->f);
+    r->f = NULL;
+}
+
+/*
+    Next line in block, reads more from file if needed.
+    Sets *line, returns length without line end, or -1 at end of file.
+    The line is not skipped, until next call.
+*/
+int pgnLine( PgnReader *r, char **line ) {
+
+    char *nl;
+    int n;
+
+    r->bpos = r->lnext;
+    if(r->bpos>=r->blen && r->eof) return -1;
+
+    n = r->blen - r->bpos;
+    nl = (n>0 ? memchr( r->blk+r->bpos, 10, (size_t)n ) : NULL);
+    if(!nl && !r->eof) {
+        n = r->blen - r->bpos;
+        memmove( r->blk, r->blk+r->bpos, n );
+        r->foff += r->bpos;
+        r->bpos = 0;
+        r->blen = n + (int)fread( r->blk+n, 1, PGN_BLOCK-n, r->f );
+        if(r->blen<PGN_BLOCK) r->eof = 1;
+        nl = memchr( r->blk, 10, r->blen );
+    }
+    *line = r->blk + r->bpos;
+    if(nl) {
+        n = (int)(nl - (*line));
+        r->lnext = r->bpos + n + 1;
+        }
+    else {
+        n = r->blen - r->bpos;      // last line, or too long
+        if(!n) return -1;
+        r->lnext = r->blen;
+        }
+    if(n>0 && (*line)[n-1]==13) n--;
+    return n;
+}
+
+/*
+    [Name "Value"] into tag list of game
+*/
+void pgnAddTag( PgnReader *r, char *s ) {
+
+    char *v, *e;
+    if(r->ntags>=PGN_TAGS) return;
+    s++;
+    while(*s==' ') s++;
+    for(v=s; *v>' ' && *v!='"' && *v!=']'; v++);
+    if(*v==0) return;
+    *(v++) = 0;
+    while(*v!=0 && *v!='"') v++;
+    if(*v==0) return;
+    v++;
+    e = strrchr( v, '"' );
+    if(e==NULL) return;
+    *e = 0;
+    r->tag[r->ntags] = s;
+    r->val[r->ntags++] = v;
+    for(e=v; *v!=0; v++) {      // unescape quotes, backslashes
+        if(*v==92 && (v[1]=='"' || v[1]==92)) v++;
+        *(e++) = *v;
+        }
+    *e = 0;
+}
+
+/*
+    Reads next game into r->game. Returns 1 if ok, 0 at end of file.
+*/
+U8 PgnNextGame( PgnReader *r ) {
+
+    char *line, *s;
+    int n, i, q = 0;
+    U8 inmoves = 0, ntag = 0;
+    char *tags[PGN_TAGS];
+
+    r->glen = r->ntags = r->nmoves = 0;
+    r->movetext = NULL;
+    r->ucis[0] = 0;
+
+    for(;;) {
+        n = pgnLine( r, &line );
+        if(n<0) break;
+        s = line;
+        while(n>0 && (*s==' ' || *s==9)) { s++; n--; }
+        if(n==0) continue;
+        if(q==0 && *s=='%') continue;       // escape line
+
+        if(!ntag && !inmoves && r->fend && r->foff+r->bpos>=r->fend) {
+            r->lnext = r->bpos;     // game of next part
+            return 0;
+            }
+
+        if(q==0 && *s=='[') {
+            if(inmoves) {
+                r->lnext = r->bpos;     // next game begins, keep this line
+                break;
+                }
+            if(ntag<PGN_TAGS && r->glen+n+2<PGN_GAME) {
+                tags[ntag++] = r->game + r->glen;
+                memcpy( r->game+r->glen, s, n );
+                r->glen += n;
+                r->game[r->glen++] = 0;
+                }
+            continue;
+            }
+        if(!inmoves) {
+            inmoves = 1;
+            r->movetext = r->game + r->glen;
+            }
+        if(r->glen+n+2<PGN_GAME) {
+            memcpy( r->game+r->glen, s, n );
+            r->glen += n;
+            r->game[r->glen++] = 10;
+            }
+        for(i=0; i<n; i++) {
+            if(q==0 && s[i]==';') break;
+            if(s[i]=='{') q++;
+            else if(s[i]=='}' && q>0) q--;
+            }
+        }
+
+    if(!ntag && !inmoves) return 0;
+    r->game[r->glen] = 0;
+    if(!inmoves) r->movetext = r->game + r->glen;
+    for(i=0; i<ntag; i++) pgnAddTag( r, tags[i] );
+    r->games++;
+    return 1;
+}
+
+/*
+    Value of tag or NULL
+*/
+char *PgnTag( PgnReader *r, char *name ) {
+    for(int i=0; i<r->ntags; i++) {
+        if(strcmp(r->tag[i],name)==0) return r->val[i];
+        }
+    return NULL;
+}
+
+/*
+    Sets position (start or [FEN]) and performs moves of game on board,
+    uci moves into r->ucis
+*/
+void PgnPlayGame( PgnReader *r ) {
+
+    char *fen = PgnTag( r, "FEN" );
+    if(fen!=NULL && *fen) SetByFEN( fen );
+    else SetStartPos();
+    r->nmoves = PgnWalk( r->movetext, r->ucis, sizeof(r->ucis), r->eval, r->clk, r->visit, r->varg );
+}
+
+//------------------------------------------
+//
+//	Large files in parallel.
+//
+//  The file is split into parts on game boundaries, each part is
+//  parsed by a worker process. It owns its own copy of the board,
+//  the MoveGen tables are shared (copy-on-write, read only).
+//  Results come back in the file order through temporary files.
+//
+
+/*
+    Positions reader at file offset, sets end of part (0-to the end)
+*/
+void PgnSeek( PgnReader *r, long long off, long long end ) {
+    fseeko( r->f, off, SEEK_SET );
+    r->foff = off;
+    r->fend = end;
+    r->bpos = r->blen = r->lnext = 0;
+    r->eof = 0;
+}
+
+/*
+    First game starting at offset or later: a tag line after
+    non-tag line. Returns file offset of it, or file size.
+*/
+long long PgnSync( PgnReader *r, long long off, long long size ) {
+
+    char *line;
+    int n;
+    U8 prevtag = 1;
+
+    if(off<=0) return 0;
+    PgnSeek( r, off-1, 0 );
+    if(pgnLine( r, &line )<0) return size;      // partial line
+    prevtag = 1;
+    while((n = pgnLine( r, &line ))>=0) {
+        while(n>0 && (*line==' ' || *line==9)) { line++; n--; }
+        if(n>0 && *line=='[') {
+            if(!prevtag) return r->foff + r->bpos;
+            prevtag = 1;
+            }
+        else prevtag = 0;
+        }
+    return size;
+}
+
+#ifndef _WIN32
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define PGN_WORKERS 64
+
+// receives games in file order, r holds tags and ucis
+typedef void (*PgnSink)( void *arg, PgnReader *r );
+
+/*
+    Game results into worker output file
+*/
+void pgnWriteGame( FILE *o, PgnReader *r ) {
+    int i, n;
+    fwrite( &r->ntags, sizeof(int), 1, o );
+    for(i=0; i<r->ntags; i++) {
+        fwrite( r->tag[i], 1, strlen(r->tag[i])+1, o );
+        fwrite( r->val[i], 1, strlen(r->val[i])+1, o );
+        }
+    n = (int)strlen(r->ucis);
+    fwrite( &r->nmoves, sizeof(int), 1, o );
+    fwrite( &n, sizeof(int), 1, o );
+    fwrite( r->ucis, 1, n, o );
+}
+
+/*
+    Reads back a game written by worker into r, returns 0 at end
+*/
+U8 pgnReadGame( FILE *o, PgnReader *r ) {
+    int i, n, c;
+    char *g = r->game, *ge = r->game+PGN_GAME;
+
+    if(fread( &n, sizeof(int), 1, o )!=1) return 0;
+    r->ntags = 0;
+    for(i=0; i<n; i++) {
+        if(i<PGN_TAGS) r->tag[r->ntags] = g;
+        while((c = fgetc(o))>0) { if(g<ge) *(g++) = (char)c; }
+        *(g++) = 0;
+        if(i<PGN_TAGS) r->val[r->ntags++] = g;
+        while((c = fgetc(o))>0) { if(g<ge) *(g++) = (char)c; }
+        *(g++) = 0;
+        if(c<0) return 0;
+        }
+    if(fread( &r->nmoves, sizeof(int), 1, o )!=1) return 0;
+    if(fread( &n, sizeof(int), 1, o )!=1) return 0;
+    if(n<0 || n>=(int)sizeof(r->ucis)) return 0;
+    if(fread( r->ucis, 1, n, o )!=(size_t)n) return 0;
+    r->ucis[n] = 0;
+    return 1;
+}
+
+/*
+    Worker, parses games of part [from,to) of file, 0 if write failed
+*/
+U8 pgnPart( PgnReader *r, FILE *in, long long from, long long to, FILE *out ) {
+    r->f = in;
+    PgnSeek( r, from, to );
+    while(PgnNextGame( r )) {
+        PgnPlayGame( r );
+        pgnWriteGame( out, r );
+        }
+    return (fflush( out )==0 && !ferror( out ));
+}
+
+/*
+    Parses PGN file by workers (0-count of CPUs),
+    calls sink for each game in order of file.
+    Returns count of games, or -1 on error (no temporary file,
+    worker failed), games of parts before are given to sink then.
+*/
+long long PgnParallel( char *path, int workers, PgnSink sink, void *arg ) {
+
+    PgnReader *r;
+    FILE *out[PGN_WORKERS], *in, *f;
+    pid_t pid[PGN_WORKERS];
+    long long starts[PGN_WORKERS+1], size, games = 0;
+    int i, st, err = 0;
+
+    if(workers<=0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(workers<1) workers = 1;
+    if(workers>PGN_WORKERS) workers = PGN_WORKERS;
+
+    r = (PgnReader *)malloc( sizeof(PgnReader) );
+    if(r==NULL) return -1;
+    if(!PgnOpen( r, path )) { free(r); return -1; }
+
+    fseeko( r->f, 0, SEEK_END );
+    size = (long long)ftello( r->f );
+    if(size < ((long long)workers<<20)) workers = (int)(size>>20) + 1;    // 1Mb at least
+
+    for(i=0; i<workers; i++) starts[i] = PgnSync( r, (size/workers)*i, size );
+    starts[workers] = size;
+
+    for(i=0; i<workers; i++) { out[i] = NULL; pid[i] = -1; }
+    for(i=0; i<workers && !err; i++) {
+        if(starts[i]>=starts[i+1]) continue;    // no games in this part
+        out[i] = tmpfile();
+        in = (out[i]!=NULL ? fopen( path, "rb" ) : NULL);     // own file position
+        if(in==NULL) { err = 1; break; }
+        fflush(NULL);
+        pid[i] = fork();
+        if(pid[i]==0) {
+            _exit( pgnPart( r, in, starts[i], starts[i+1], out[i] ) ? 0 : 1 );
+            }
+        if(pid[i]<0) {          // could not fork, do it here
+            f = r->f;
+            if(!pgnPart( r, in, starts[i], starts[i+1], out[i] )) err = 1;
+            r->f = f;
+            pid[i] = 0;
+            }
+        fclose( in );
+        }
+
+        // merge in order, as soon as part is done
+    for(i=0; i<workers; i++) {
+        if(pid[i]>0 && (waitpid( pid[i], &st, 0 )!=pid[i] || !WIFEXITED(st) || WEXITSTATUS(st)!=0)) err = 1;
+        if(pid[i]>=0 && !err) {
+            rewind( out[i] );
+            while(pgnReadGame( out[i], r )) {
+                games++;
+                sink( arg, r );
+                }
+            }
+        if(out[i]!=NULL) fclose( out[i] );
+        }
+
+    PgnClose( r );
+    free( r );
+    return (err ? -1 : games);
+}
+
+#endif  /* _WIN32 */
+
+//------------------------------------------
+//
+//	Files mapped to memory read-only (shared by processes),
+//  read into memory on Windows.
+//
+
+const U8 *MapFile( char *path, long long *size ) {
+
+    U8 *p = NULL;
+    *size = 0;
+#ifdef _WIN32
+    FILE *f = fopen( path, "rb" );
+    if(f==NULL) return NULL;
+    fseeko( f, 0, SEEK_END );
+    *size = ftello( f );
+    fseeko( f, 0, SEEK_SET );
+    p = (U8 *)malloc( *size+1 );
+    if(p!=NULL && fread( p, 1, *size, f )!=(size_t)*size) { free(p); p = NULL; }
+    fclose( f );
+#else
+    struct stat st;
+    int fd = open( path, O_RDONLY );
+    if(fd<0) return NULL;
+    if(fstat( fd, &st )==0) {
+        *size = st.st_size;
+        p = (U8 *)mmap( NULL, (*size>0 ? *size : 1), PROT_READ, MAP_SHARED, fd, 0 );
+        if(p==(U8 *)MAP_FAILED) p = NULL;
+        }
+    close(fd);
+#endif
+    return p;
+}
+
+void UnMapFile( const U8 *p, long long size ) {
+    if(p==NULL) return;
+#ifdef _WIN32
+    free( (void *)p );
+#else
+    munmap( (void *)p, (size>0 ? size : 1) );
+#endif
+}
+
+//------------------------------------------
+//
+//	Compact game files.
+//  Each move is one byte, its index in the MoveGen list.
+//  File:   "U64GAME1", games, index of U64 offsets, U64 index offset, U64 count
+//  Game:   U8 flags (bits 0-1 result, bit 2 start position follows),
+//          U16 count of plies, [POS_BYTES start position], moves
+//
+
+#define GAMES_MAGIC "U64GAME1"
+
+CONST char *game_results[] = { "*", "1-0", "0-1", "1/2-1/2" };
+
+U8 GameResult( char *res ) {
+    for(U8 i=1; i<4; i++) {
+        if(res!=NULL && strcmp(res,game_results[i])==0) return i;
+        }
+    return 0;
+}
+
+/*
+    uci moves from current position into bytes, size at most.
+    Board is at the last move. Returns count of moves (bytes),
+    or -1 if a move is not legal or there are more than size.
+*/
+int GameEncode( char *ucis, U8 *out, int size ) {
+
+    U8 mv[4<<8], *p, i, n;
+    char uci[8], *s = ucis;
+    int k, cnt = 0;
+
+    while(*s>13) {
+        while(*s==32) s++;
+        if(*s<=32) break;
+        for( k=0; *s>32 && k<5; k++) uci[k] = *(s++);
+        uci[k] = 0;
+        while(*s>32) s++;
+        if(k<4 || cnt>=size) return -1;
+
+        MoveGen( mv );
+        n = mv[0];
+        for(i=0, p=mv+1; i<n; i++, p+=4) {
+            if(p[1]==(((uci[1]-'1')<<3)|((uci[0]-'a')&7)) &&
+                p[2]==(((uci[3]-'1')<<3)|((uci[2]-'a')&7)) &&
+                (uci[4]==0 || !(p[3]&2) || uci[4]==pieces[8+((p[3]>>2)&3)])) break;
+            }
+        if(i==n) return -1;
+        DoMove( p );
+        out[cnt++] = i;
+        }
+    return cnt;
+}
+
+/*
+    Plays n moves of bytes from current position,
+    ucis gets uci moves of size bytes at most.
+    Returns count of moves made.
+*/
+int GameDecode( const U8 *in, int n, char *ucis, int size ) {
+
+    U8 mv[4<<8], *p;
+    char *u = ucis, *ue = ucis+size-8;
+    int k;
+
+    *u = 0;
+    for(k=0; k<n && u<ue; k++) {
+        MoveGen( mv );
+        if(in[k]>=mv[0]) break;
+        p = mv+1+(in[k]<<2);
+        DoMove( p );
+        *(u++) = (p[1]&7)+'a'; *(u++) = (p[1]>>3)+'1';
+        *(u++) = (p[2]&7)+'a'; *(u++) = (p[2]>>3)+'1';
+        if(p[3]&2) *(u++) = pieces[8+((p[3]>>2)&3)];
+        *(u++) = ' ';
+        *u = 0;
+        }
+    return k;
+}
+
+typedef struct {
+    FILE *f;
+    long long n, cap, off;
+    U64 *offs;
+} GameWriter;
+
+U8 GamesCreate( GameWriter *w, char *path ) {
+    w->n = w->cap = 0;
+    w->offs = NULL;
+    w->f = fopen( path, "wb" );
+    if(w->f==NULL) return 0;
+    fwrite( GAMES_MAGIC, 1, 8, w->f );
+    w->off = 8;
+    return 1;
+}
+
+/*
+    Adds game of n moves, start is POS_BYTES position or NULL if usual.
+*/
+U8 GamesAdd( GameWriter *w, U8 result, const U8 *start, const U8 *mvs, int n ) {
+
+    U8 h[3];
+    U64 *o;
+
+    if(w->n==w->cap) {
+        w->cap = (w->cap ? w->cap<<1 : 1024);
+        o = (U64 *)realloc( w->offs, w->cap*sizeof(U64) );
+        if(o==NULL) return 0;
+        w->offs = o;
+        }
+    w->offs[w->n++] = (U64)w->off;
+    h[0] = (result&3)|(start!=NULL ? 4 : 0);
+    h[1] = (U8)n; h[2] = (U8)(n>>8);
+    fwrite( h, 1, 3, w->f );
+    if(start!=NULL) fwrite( start, 1, POS_BYTES, w->f );
+    fwrite( mvs, 1, n, w->f );
+    w->off += 3+(start!=NULL ? POS_BYTES : 0)+n;
+    return 1;
+}
+
+/*
+    Writes index, closes file. Returns count of games or -1.
+*/
+long long GamesFinish( GameWriter *w ) {
+
+    U8 b[8];
+    long long i, n = w->n;
+    int k;
+
+    for(i=0; i<=n+1; i++) {
+        U64 v = (i<n ? w->offs[i] : (i==n ? (U64)w->off : (U64)n));
+        for(k=0; k<8; k++) b[k] = (U8)(v>>(k<<3));
+        fwrite( b, 1, 8, w->f );
+        }
+    free( w->offs );
+    w->offs = NULL;
+    if(fclose( w->f )!=0) n = -1;
+    w->f = NULL;
+    return n;
+}
+
+/*
+    Converts PGN file into compact games file (appends to w),
+    games with moves not legal are skipped. Returns count of games or -1.
+*/
+long long GamesFromPgn( GameWriter *w, char *pgn ) {
+
+    PgnReader *r = (PgnReader *)malloc( sizeof(PgnReader) );
+    U8 start[POS_BYTES], mvs[PGN_PLIES];
+    long long cnt = 0;
+    char *fen;
+    int n;
+
+    if(r==NULL) return -1;
+    if(!PgnOpen( r, pgn )) { free(r); return -1; }
+    while(PgnNextGame( r )) {
+        PgnPlayGame( r );
+        fen = PgnTag( r, "FEN" );
+        if(fen!=NULL && *fen) SetByFEN( fen );
+        else SetStartPos();
+        PosEncode( start );
+        n = GameEncode( r->ucis, mvs, PGN_PLIES );
+        if(n<0) continue;
+        if(!GamesAdd( w, GameResult( PgnTag( r, "Result" ) ), (fen!=NULL && *fen ? start : NULL), mvs, n )) break;
+        cnt++;
+        }
+    PgnClose( r );
+    free( r );
+    return cnt;
+}
+
+typedef struct {
+    const U8 *data;
+    long long size, n;
+    const U8 *index;
+} GameFile;
+
+U64 gamesU64( const U8 *p ) {
+    U64 v = 0;
+    for(int k=7; k>=0; k--) v = (v<<8)|p[k];
+    return v;
+}
+
+U8 GamesOpen( GameFile *g, char *path ) {
+
+    U64 io;
+    g->data = MapFile( path, &g->size );
+    if(g->data==NULL) return 0;
+    if(g->size<24 || memcmp( g->data, GAMES_MAGIC, 8 )!=0) {
+        UnMapFile( g->data, g->size );
+        g->data = NULL;
+        return 0;
+        }
+    io = gamesU64( g->data+g->size-16 );
+    g->n = (long long)gamesU64( g->data+g->size-8 );
+    if(g->n<0 || (U64)g->n > (U64)g->size/8 || io<8 ||
+        io+(U64)g->n*8+16 != (U64)g->size) {
+        UnMapFile( g->data, g->size );
+        g->data = NULL;
+        return 0;
+        }
+    g->index = g->data+io;
+    return 1;
+}
+
+void GamesClose( GameFile *g ) {
+    UnMapFile( g->data, g->size );
+    g->data = NULL;
+    g->n = 0;
+}
+
+/*
+    Sets start position of game i and plays it, ucis gets uci moves.
+    Returns result (0-3) or -1 if no such game.
+*/
+int GamesPlay( GameFile *g, long long i, char *ucis, int size ) {
+
+    const U8 *p, *h;
+    U64 off, end = (U64)(g->index-g->data);
+    int n;
+
+    if(i<0 || i>=g->n) return -1;
+    off = gamesU64( g->index+(i<<3) );
+    if(off<8 || off+3>end) return -1;       // games are before the index
+    h = p = g->data+off;
+    n = h[1]|(h[2]<<8);
+    if(off+3+((h[0]&4) ? POS_BYTES : 0)+n > end) return -1;
+    p += 3;
+    if(h[0]&4) {
+        if(!PosDecode( p )) return -1;
+        p += POS_BYTES;
+        }
+    else SetStartPos();
+    GameDecode( p, n, ucis, size );
+    return (h[0]&3);
+}
+
+#endif  /* _INC_u64_PGN */
@@ -1,7 +1,12 @@
 #ifndef _INC_u64_POLYGLOT
 #define _INC_u64_POLYGLOT
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "u64_chess.h"
+#include "u64_pgn.h"
 
 CONST U64 polyglot_Random64[781] = {
   0x9D39247E33776D41LL, 0x2AF7398005AAA5C7LL, 0x44DB015024623547LL, 0x9C15F73E62A76AE2,
@@ -268,4 +273,374 @@ U64 getPolyglotKey() {
 	return key;
 }
 
+//------------------------------------------
+//
+//	Polyglot .bin book reading.
+//  The book is mapped to memory read-only (MapFile), so processes share it.
+//  Entries are 16 bytes big-endian, sorted by key:
+//      key 8, move 2, weight 2, learn 4
+//
+
+typedef struct {
+    const U8 *data;
+    long long n;                // count of entries
+    long long size;
+} PolyBook;
+
+typedef struct {
+    char uci[6];
+    U16 weight;
+    U32 learn;
+} PolyMove;
+
+#define BOOK_MOVES 64           // max.moves of position
+#define BOOK_RUNS 1024          // max.sorted runs of book builder
+
+U64 bookU64( const U8 *p, int n ) {
+    U64 v = 0;
+    for(int i=0; i<n; i++) v = (v<<8)|p[i];
+    return v;
+}
+
+U8 BookOpen( PolyBook *b, char *path ) {
+    b->data = MapFile( path, &b->size );
+    b->n = b->size>>4;
+    return (b->data!=NULL ? 1 : 0);
+}
+
+void BookClose( PolyBook *b ) {
+    UnMapFile( b->data, b->size );
+    b->data = NULL;
+    b->n = b->size = 0;
+}
+
+/*
+    Index of first entry with key, or b->n if none
+*/
+long long BookFind( PolyBook *b, U64 key ) {
+    long long lo = 0, hi = b->n, m;
+    while(lo<hi) {
+        m = (lo+hi)>>1;
+        if(bookU64( b->data+(m<<4), 8 ) < key) lo = m+1;
+        else hi = m;
+        }
+    if(lo<b->n && bookU64( b->data+(lo<<4), 8 )==key) return lo;
+    return b->n;
+}
+
+/*
+    Polyglot move to uci, castling e1h1 is king to g1 etc.
+    Returns 0 if promotion piece is not valid (corrupt entry).
+*/
+U8 bookUci( U16 m, char *uci ) {
+
+    U8 fr = (m>>6)&63, to = m&63, pr = (m>>12)&7;
+
+    if(pr>4) return 0;
+    if((fr==4 && (WK & 16LL)) || (fr==60 && (BK & (1LL<<60)))) {
+        if((to&7)==7) to = fr+2;
+        else if((to&7)==0) to = fr-2;
+        }
+    uci[0] = (fr&7)+'a'; uci[1] = (fr>>3)+'1';
+    uci[2] = (to&7)+'a'; uci[3] = (to>>3)+'1';
+    uci[4] = (pr ? " nbrq"[pr] : 0);
+    uci[5] = 0;
+    return 1;
+}
+
+/*
+    Moves of current position, BOOK_MOVES at most.
+    Returns count.
+*/
+int BookMoves( PolyBook *b, PolyMove *mvs ) {
+
+    U64 key = getPolyglotKey();
+    long long i = BookFind( b, key );
+    const U8 *p;
+    int n = 0;
+
+    for(; i<b->n && n<BOOK_MOVES; i++) {
+        p = b->data+(i<<4);
+        if(bookU64( p, 8 )!=key) break;
+        if(!bookUci( (U16)bookU64( p+8, 2 ), mvs[n].uci )) continue;
+        mvs[n].weight = (U16)bookU64( p+10, 2 );
+        mvs[n].learn = (U32)bookU64( p+12, 4 );
+        n++;
+        }
+    return n;
+}
+
+/*
+    Weighted random move, rnd is 32-bit random (scaled to sum of weights).
+    Returns 0 if no moves in book.
+*/
+U8 BookPick( PolyBook *b, U32 rnd, char *uci ) {
+
+    PolyMove mvs[BOOK_MOVES];
+    int n = BookMoves( b, mvs ), i;
+    U32 sum = 0, r;
+
+    if(n==0) return 0;
+    for(i=0; i<n; i++) sum += mvs[i].weight;
+    if(sum==0) { strcpy( uci, mvs[((U64)rnd*n)>>32].uci ); return 1; }
+    r = (U32)(((U64)rnd*sum)>>32);
+    for(i=0; i<n-1 && r>=mvs[i].weight; i++) r -= mvs[i].weight;
+    strcpy( uci, mvs[i].uci );
+    return 1;
+}
+
+//------------------------------------------
+//
+//	Polyglot book building from PGN files.
+//  (key, move) counts are summed in an open-addressing hash table,
+//  when it is full, it is sorted and spilled to a temporary file (run).
+//  At the end runs are merged (k-way, by heap) into .bin file.
+//  Weight of move is 2 for win, 1 for draw, 0 for loss of side who moved,
+//  learn is the count of games.
+//
+
+typedef struct {
+    U64 key;
+    U32 weight;
+    U32 games;
+    U16 move;
+} BookRec;
+
+typedef struct {
+    BookRec *tab;
+    U64 mask;                   // table size-1
+    U64 used, limit;
+    FILE *runs[BOOK_RUNS];
+    int nruns;
+    U64 key;                    // polyglot key before the move
+    int ply, maxply;
+    U8 score[2];                // weight for white, black
+    U8 err;
+} BookBuilder;
+
+/*
+    uci to polyglot move, king to g1 is e1h1 etc.,
+    called after the move is made
+*/
+U16 bookMove( char *uci ) {
+
+    U8 fr = ((uci[1]-'1')<<3)|(uci[0]-'a'), to = ((uci[3]-'1')<<3)|(uci[2]-'a');
+    U8 pr = 0;
+    U64 k = (1LL<<to);
+
+    if((fr==4 && (WK & k)) || (fr==60 && (BK & k))) {
+        if(to==fr+2) to = fr+3;
+        else if(to==fr-2) to = fr-4;
+        }
+    switch(uci[4]) {
+        case 'n': pr = 1; break;
+        case 'b': pr = 2; break;
+        case 'r': pr = 3; break;
+        case 'q': pr = 4; break;
+        }
+    return (U16)(to|(fr<<6)|(pr<<12));
+}
+
+int bookRecCmp( const void *a, const void *b ) {
+    const BookRec *x = (const BookRec *)a, *y = (const BookRec *)b;
+    if(x->key!=y->key) return (x->key<y->key ? -1 : 1);
+    return (int)x->move - (int)y->move;
+}
+
+/*
+    Sorts table into a run file, clears table
+*/
+void bookSpill( BookBuilder *bb ) {
+
+    U64 i, n = 0;
+    FILE *f;
+
+    if(bb->used==0) return;
+    if(bb->nruns==BOOK_RUNS || (f = tmpfile())==NULL) { bb->err = 1; return; }
+    for(i=0; i<=bb->mask; i++) {
+        if(bb->tab[i].games) bb->tab[n++] = bb->tab[i];
+        }
+    qsort( bb->tab, n, sizeof(BookRec), bookRecCmp );
+    if(fwrite( bb->tab, sizeof(BookRec), n, f )!=n) bb->err = 1;
+    rewind( f );
+    bb->runs[bb->nruns++] = f;
+    memset( bb->tab, 0, (bb->mask+1)*sizeof(BookRec) );
+    bb->used = 0;
+}
+
+void bookAdd( BookBuilder *bb, U64 key, U16 move, U32 weight ) {
+
+    U64 i = (key ^ (move*0x9E3779B97F4A7C15LL)) & bb->mask;
+    BookRec *e;
+
+    for(;;) {
+        e = bb->tab+i;
+        if(e->games==0) break;
+        if(e->key==key && e->move==move) {
+            e->weight += weight;
+            e->games++;
+            return;
+            }
+        i = (i+1) & bb->mask;
+        }
+    e->key = key;
+    e->move = move;
+    e->weight = weight;
+    e->games = 1;
+    if(++bb->used>=bb->limit) bookSpill( bb );
+}
+
+/*
+    PgnVisit of main line moves
+*/
+void bookVisit( void *arg, PgnTok *t, int depth, char *uci ) {
+
+    BookBuilder *bb = (BookBuilder *)arg;
+    if(uci==NULL || depth>0) return;
+    if(bb->ply<bb->maxply) {
+        bookAdd( bb, bb->key, bookMove( uci ), bb->score[ToMove^1] );
+        bb->key = getPolyglotKey();
+        }
+    bb->ply++;
+}
+
+void bookPut( U8 *p, U64 v, int n ) {
+    for(int i=n-1; i>=0; i--) { p[i] = (U8)v; v >>= 8; }
+}
+
+int bookWeightCmp( const void *a, const void *b ) {
+    const BookRec *x = (const BookRec *)a, *y = (const BookRec *)b;
+    if(x->weight!=y->weight) return (x->weight>y->weight ? -1 : 1);
+    return (int)x->move - (int)y->move;
+}
+
+/*
+    Writes moves of one position, weights scaled to 16 bits.
+    Returns count of entries written.
+*/
+long long bookFlush( FILE *o, BookRec *g, int n, U32 mingames ) {
+
+    U32 mx = 0;
+    int i, k = 0;
+    U8 e[16];
+
+    for(i=0; i<n; i++) {
+        if(g[i].games>=mingames) {
+            g[k++] = g[i];
+            if(g[i].weight>mx) mx = g[i].weight;
+            }
+        }
+    qsort( g, k, sizeof(BookRec), bookWeightCmp );
+    for(i=0; i<k; i++) {
+        bookPut( e, g[i].key, 8 );
+        bookPut( e+8, g[i].move, 2 );
+        bookPut( e+10, (mx>65535 ? ((U64)g[i].weight*65535)/mx : g[i].weight), 2 );
+        bookPut( e+12, g[i].games, 4 );
+        fwrite( e, 16, 1, o );
+        }
+    return k;
+}
+
+/*
+    Merges sorted runs into book file, sums same (key, move).
+    Returns count of entries or -1.
+*/
+long long bookMerge( BookBuilder *bb, char *out, U32 mingames ) {
+
+    BookRec cur[BOOK_RUNS], grp[BOOK_MOVES*4], r;
+    int heap[BOOK_RUNS], nh = 0, i, j, c, ng = 0;
+    long long cnt = 0;
+    FILE *o = fopen( out, "wb" );
+
+    if(o==NULL) return -1;
+
+    for(i=0; i<bb->nruns; i++) {        // heap of runs by current record
+        if(fread( &cur[i], sizeof(BookRec), 1, bb->runs[i] )!=1) continue;
+        for(j=nh++; j>0 && bookRecCmp( &cur[i], &cur[heap[(j-1)>>1]] )<0; j=(j-1)>>1) heap[j] = heap[(j-1)>>1];
+        heap[j] = i;
+        }
+
+    while(nh>0) {
+        i = heap[0];
+        r = cur[i];
+        if(ng>0 && grp[ng-1].key==r.key && grp[ng-1].move==r.move) {
+            grp[ng-1].weight += r.weight;
+            grp[ng-1].games += r.games;
+            }
+        else {
+            if(ng>0 && grp[0].key!=r.key) {
+                cnt += bookFlush( o, grp, ng, mingames );
+                ng = 0;
+                }
+            if(ng<BOOK_MOVES*4) grp[ng++] = r;
+            }
+        if(fread( &cur[i], sizeof(BookRec), 1, bb->runs[i] )!=1) i = heap[--nh];
+        for(j=0;;) {                    // sift down
+            c = (j<<1)+1;
+            if(c>=nh) break;
+            if(c+1<nh && bookRecCmp( &cur[heap[c+1]], &cur[heap[c]] )<0) c++;
+            if(bookRecCmp( &cur[heap[c]], &cur[i] )>=0) break;
+            heap[j] = heap[c];
+            j = c;
+            }
+        if(nh>0) heap[j] = i;
+        }
+    if(ng>0) cnt += bookFlush( o, grp, ng, mingames );
+
+    if(fclose( o )!=0) return -1;
+    return cnt;
+}
+
+/*
+    Builds polyglot book out of PGN files, first maxply plies of games,
+    moves played in less than mingames are left out, games without
+    result (*) too, memmb megabytes for the table.
+    Returns count of book entries, or -1 on error.
+*/
+long long BookBuild( char **paths, int npaths, char *out, int maxply, int mingames, int memmb ) {
+
+    BookBuilder bb;
+    PgnReader *r;
+    U64 n = 1024;
+    long long cnt = -1;
+    char *res;
+    int i;
+
+    if(memmb<1) memmb = 1;
+    while((n<<1)*sizeof(BookRec) <= ((U64)memmb<<20)) n <<= 1;
+    memset( &bb, 0, sizeof(bb) );
+    bb.tab = (BookRec *)calloc( n, sizeof(BookRec) );
+    r = (PgnReader *)malloc( sizeof(PgnReader) );
+    if(bb.tab==NULL || r==NULL) { free(bb.tab); free(r); return -1; }
+    bb.mask = n-1;
+    bb.limit = (n*3)>>2;
+    bb.maxply = maxply;
+
+    for(i=0; i<npaths && !bb.err; i++) {
+        if(!PgnOpen( r, paths[i] )) { bb.err = 1; break; }
+        while(!bb.err && PgnNextGame( r )) {
+            res = PgnTag( r, "Result" );
+            if(res==NULL) continue;
+            if(strcmp(res,"1-0")==0) { bb.score[0] = 2; bb.score[1] = 0; }
+            else if(strcmp(res,"0-1")==0) { bb.score[0] = 0; bb.score[1] = 2; }
+            else if(strcmp(res,"1/2-1/2")==0) bb.score[0] = bb.score[1] = 1;
+            else continue;          // unfinished
+            res = PgnTag( r, "FEN" );
+            if(res!=NULL && *res) SetByFEN( res );
+            else SetStartPos();
+            bb.key = getPolyglotKey();
+            bb.ply = 0;
+            r->nmoves = PgnWalk( r->movetext, r->ucis, sizeof(r->ucis), NULL, NULL, bookVisit, &bb );
+            }
+        PgnClose( r );
+        }
+    free( r );
+
+    if(!bb.err) bookSpill( &bb );
+    free( bb.tab );
+    if(!bb.err) cnt = bookMerge( &bb, out, (U32)mingames );
+    for(i=0; i<bb.nruns; i++) fclose( bb.runs[i] );
+    return cnt;
+}
+
 #endif  /* _INC_u64_POLYGLOT */
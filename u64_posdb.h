@@ -0,0 +1,155 @@
+/*
+ ---------------------------------------------
+
+    u64_posdb  position database for u64_chess
+
+    Fixed-size value records keyed by polyglot key (getPolyglotKey),
+    on disk as an open-addressing hash table, mapped to memory
+    read-only, so lookups need no loading and no locks, and
+    processes share the pages.
+
+    Built at once (bulk load): records are sorted by key,
+    which is also the order of home slots (top bits of key),
+    so the table is written sequentially, linear probing
+    goes on into a tail after the last slot instead of wrapping.
+
+---------------------------------------------
+*/
+
+#ifndef _INC_u64_POSDB
+#define _INC_u64_POSDB
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "u64_chess.h"
+#include "u64_pgn.h"
+
+//  File:   64 bytes header, then slots of U64 key + value bytes
+//          (little-endian), key 0 is an empty slot.
+
+#define POSDB_MAGIC "U64PDB01"
+
+typedef struct {
+    const U8 *data;
+    long long size;
+    const U8 *slots;
+    int bits;                   // home slot is top bits of key
+    int rec;                    // bytes of value
+    long long count;            // records
+    long long nslots;           // slots with the tail
+} PosDb;
+
+typedef struct {
+    U64 key;
+    long long idx;
+} posdbKey;
+
+int posdbCmp( const void *a, const void *b ) {
+    const posdbKey *x = (const posdbKey *)a, *y = (const posdbKey *)b;
+    if(x->key!=y->key) return (x->key<y->key ? -1 : 1);
+    return (x->idx<y->idx ? -1 : (x->idx>y->idx ? 1 : 0));
+}
+
+/*
+    Writes database of n keys and values (rec bytes each).
+    Same keys keep the last value, key 0 is left out.
+    Returns count of records, or -1 on error.
+*/
+long long PosDbBuild( char *path, const U64 *keys, const U8 *vals, long long n, int rec ) {
+
+    posdbKey *k;
+    U64 hd[8];
+    long long i, j, pos = 0, cnt = 0, home;
+    int bits = 1;
+    U8 *zero;
+    FILE *f;
+
+    if(rec<0 || n<0) return -1;
+    while(bits<62 && (1LL<<bits) < (n<<1)) bits++;      // half full
+    k = (posdbKey *)malloc( (n>0 ? n : 1)*sizeof(posdbKey) );
+    zero = (U8 *)calloc( 1, 8+rec );
+    f = fopen( path, "wb" );
+    if(k==NULL || zero==NULL || f==NULL) {
+        free(k); free(zero);
+        if(f!=NULL) fclose(f);
+        return -1;
+        }
+    for(i=0; i<n; i++) { k[i].key = keys[i]; k[i].idx = i; }
+    qsort( k, n, sizeof(posdbKey), posdbCmp );
+
+    memset( hd, 0, sizeof(hd) );
+    fwrite( hd, 1, sizeof(hd), f );         // header at the end
+
+    for(i=0; i<n; i=j) {
+        for(j=i+1; j<n && k[j].key==k[i].key; j++);
+        if(k[i].key==0) continue;
+        home = (long long)(k[i].key>>(64-bits));
+        for(; pos<home; pos++) fwrite( zero, 1, 8+rec, f );
+        fwrite( &k[i].key, 1, 8, f );
+        fwrite( vals+(k[j-1].idx*rec), 1, rec, f );
+        pos++;
+        cnt++;
+        }
+    for(; pos<(1LL<<bits); pos++) fwrite( zero, 1, 8+rec, f );
+    fwrite( zero, 1, 8+rec, f );            // empty slot ends probing
+
+    memcpy( hd, POSDB_MAGIC, 8 );
+    hd[1] = bits;
+    hd[2] = rec;
+    hd[3] = cnt;
+    hd[4] = pos+1;
+    fseeko( f, 0, SEEK_SET );
+    fwrite( hd, 1, sizeof(hd), f );
+
+    free(k);
+    free(zero);
+    if(fclose( f )!=0) return -1;
+    return cnt;
+}
+
+U8 PosDbOpen( PosDb *d, char *path ) {
+
+    U64 hd[8];
+    d->data = MapFile( path, &d->size );
+    if(d->data==NULL) return 0;
+    if(d->size>=64) memcpy( hd, d->data, sizeof(hd) );
+    if(d->size<64 || memcmp( d->data, POSDB_MAGIC, 8 )!=0 ||
+        64+(long long)hd[4]*(8+(long long)hd[2]) != d->size) {
+        UnMapFile( d->data, d->size );
+        d->data = NULL;
+        return 0;
+        }
+    d->bits = (int)hd[1];
+    d->rec = (int)hd[2];
+    d->count = (long long)hd[3];
+    d->nslots = (long long)hd[4];
+    d->slots = d->data+64;
+    return 1;
+}
+
+void PosDbClose( PosDb *d ) {
+    UnMapFile( d->data, d->size );
+    d->data = NULL;
+}
+
+/*
+    Value of key, NULL if not found
+*/
+const U8 *PosDbGet( PosDb *d, U64 key ) {
+
+    long long i = (long long)(key>>(64-d->bits));
+    const U8 *p;
+    U64 k;
+
+    for(; i<d->nslots; i++) {
+        p = d->slots+i*(8+d->rec);
+        memcpy( &k, p, 8 );
+        if(k==key) return p+8;
+        if(k==0 || k>key) return NULL;     // sorted run of slots
+        }
+    return NULL;
+}
+
+#endif  /* _INC_u64_POSDB */
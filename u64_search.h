@@ -0,0 +1,556 @@
+/*
+ ---------------------------------------------
+
+    u64_search  searches for u64_chess
+
+    Mate in N solver, as Sample2 puzzle search, but for any N:
+    checking moves of attacker first, cut-off on the first
+    refutation of defender (tried first next time, killer),
+    transposition table of proven results, endgame tables
+    at leaf nodes.
+
+    Random playouts, for statistics of positions: MoveGen without
+    check+ flags, xorshift random moves, forked workers on copies
+    of the board.
+
+    Move ordering for alpha-beta searches: scores of MoveGen list by
+    best move, MVV-LVA and SEE of captures, killers, counter-moves
+    and history of quiet moves, picked one by one (selection of the
+    best left), as cut-offs mostly come at the first moves.
+
+---------------------------------------------
+*/
+
+#ifndef _INC_u64_SEARCH
+#define _INC_u64_SEARCH
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+#include "u64_chess.h"
+#include "u64_egtb.h"
+
+#define MATE_TT_BITS 20             // 16MB
+#define MATE_MAX 64                 // max moves to mate
+
+typedef struct {
+    U64 key;
+    U8 mate;                        // mates in this count of moves, 0-not known
+    U8 nomate;                      // does not mate in this count of moves
+} MateTT;
+
+MateTT *mate_tt = NULL;
+U8 mate_checks = 0;                 // 1-attacker plays only check+ moves
+U8 mate_killer[MATE_MAX+1][2];      // refutation squares by moves left
+long long mate_nodes = 0;
+
+CONST U64 mate_salt_def = 0x5851F42D4C957F2DLL;    // defender to move
+CONST U64 mate_salt_chk = 0x14057B7EF767814FLL;    // only checks mode
+
+MateTT *mateEntry( U8 def ) {
+    U64 key = BoardHash() ^ (def ? mate_salt_def : 0) ^ (mate_checks ? mate_salt_chk : 0);
+    MateTT *e = &mate_tt[key & ((1<<MATE_TT_BITS)-1)];
+    if(e->key!=key) { e->key = key; e->mate = 0; e->nomate = 0; }
+    return e;
+}
+
+U8 mateDefend( U8 n );
+
+/*
+    Side to move mates in n moves or less?
+*/
+U8 mateAttack( U8 n ) {
+
+    U8 list[4<<8], *p, i, cnt, pass, r = 0;
+    int w;
+    MateTT *e;
+
+    mate_nodes++;
+    MoveGen( list );
+    cnt = list[0];
+    for(i=0, p=list+1; i<cnt; i++, p+=4) {
+        if(p[3]&128) return 1;
+        }
+    if(n<2) return 0;
+    if((w = TbProbeWDL())!=TB_NONE && w<=0) return 0;
+
+    e = mateEntry( 0 );
+    if(e->mate && e->mate<=n) return 1;
+    if(e->nomate>=n) return 0;
+
+    for(pass=0; pass<2 && !r; pass++) {     // check+ moves first
+        if(pass && mate_checks) break;
+        for(i=0, p=list+1; i<cnt && !r; i++, p+=4) {
+            if(((p[3]&64) ? 0 : 1)!=pass) continue;
+            DoMove( p );
+            r = mateDefend( n-1 );
+            UnDoMove();
+            }
+        }
+
+    e = mateEntry( 0 );                     // could be replaced deeper
+    if(r) { if(!e->mate || n<e->mate) e->mate = n; }
+    else if(n>e->nomate) e->nomate = n;
+    return r;
+}
+
+/*
+    Side to move gets mated in n moves or less, whatever it does?
+*/
+U8 mateDefend( U8 n ) {
+
+    U8 list[4<<8], *p, *k = mate_killer[n], i, cnt, pass, r = 1;
+    int w;
+    MateTT *e;
+
+    mate_nodes++;
+    MoveGen( list );
+    cnt = list[0];
+    if(cnt==0) return IsCheckNow();         // mate or stalemate
+    if((w = TbProbeWDL())!=TB_NONE && w>=0) return 0;
+
+    e = mateEntry( 1 );
+    if(e->mate && e->mate<=n) return 1;
+    if(e->nomate>=n) return 0;
+
+    for(pass=0; pass<2 && r; pass++) {      // killer first
+        for(i=0, p=list+1; i<cnt && r; i++, p+=4) {
+            if(((p[1]==k[0] && p[2]==k[1]) ? 0 : 1)!=pass) continue;
+            DoMove( p );
+            r = mateAttack( n );
+            UnDoMove();
+            if(!r) { k[0] = p[1]; k[1] = p[2]; }
+            }
+        }
+
+    e = mateEntry( 1 );
+    if(r) { if(!e->mate || n<e->mate) e->mate = n; }
+    else if(n>e->nomate) e->nomate = n;
+    return r;
+}
+
+/*
+    All moves of current position that mate in n moves or less.
+    Moves go to mvs (4 bytes each), count of moves to mate to plies.
+    checks: 1-attacker plays only check+ moves (faster, may miss quiet keys).
+    Returns count of solutions, or -1 if no memory.
+*/
+int SolveMate( U8 n, U8 checks, U8 *mvs, U8 *moves ) {
+
+    U8 list[4<<8], *p, i, cnt, d;
+    int found = 0;
+
+    if(mate_tt==NULL) {
+        mate_tt = (MateTT *)calloc( 1<<MATE_TT_BITS, sizeof(MateTT) );
+        if(mate_tt==NULL) return -1;
+        }
+    if(n>MATE_MAX) n = MATE_MAX;
+    mate_checks = checks;
+    memset( mate_killer, 0, sizeof(mate_killer) );
+
+    MoveGen( list );
+    cnt = list[0];
+    for(i=0, p=list+1; i<cnt; i++, p+=4) {
+        if(checks && !(p[3]&64)) continue;
+        d = 0;
+        if(p[3]&128) d = 1;
+        else if(n>1) {
+            DoMove( p );
+            for(d=2; d<=n && !mateDefend( d-1 ); d++);
+            UnDoMove();
+            if(d>n) d = 0;
+            }
+        if(d) {
+            memcpy( mvs+(found<<2), p, 4 );
+            moves[found++] = d;
+            }
+        }
+    return found;
+}
+
+//------------------------------------------
+//
+//	Playouts
+//
+
+#define PO_UNIFORM 0            // any legal move
+#define PO_CAPTURES 1           // captures, promotions at half of moves, if any
+#define PO_WORKERS 64
+
+typedef struct {
+    long long win, draw, loss;  // of side to move at start
+    long long unfinished;       // max plies reached
+    long long plies;
+} PlayoutStats;
+
+U64 po_rnd = 0x9E3779B97F4A7C15LL;     // xorshift state
+int po_plies;                           // of the last playout
+
+U64 poRandom() {
+    po_rnd ^= po_rnd<<13;
+    po_rnd ^= po_rnd>>7;
+    po_rnd ^= po_rnd<<17;
+    return po_rnd;
+}
+
+/*
+    One random game of current position, board is restored.
+    Returns 1-win, 0-draw, -1-loss of side to move, 2-unfinished.
+*/
+int Playout( int maxply, U8 policy ) {
+
+    U8 list[4<<8], *p, cnt, i, j, nc, stm = ToMove;
+    U64 *undo = undo_p, r;
+    int ply, res = 2, room;
+
+    room = (int)((undobuffer+UNDO_REC*UNDO_PLIES-undo_p)/UNDO_REC) - 1;
+    if(maxply>room) maxply = room;
+
+    for(ply=0; ply<maxply; ply++) {
+        if(HalfMoves>=100 || InsufficientMaterial() || Repetitions()>=3) { res = 0; break; }
+        MoveGen( list );
+        cnt = list[0];
+        if(cnt==0) {
+            res = (IsCheckNow() ? (ToMove==stm ? -1 : 1) : 0);
+            break;
+            }
+        r = poRandom();
+        i = (U8)(((r>>32)*cnt)>>32);
+        if(policy==PO_CAPTURES && (r&1)) {
+            for(j=nc=0, p=list+1; j<cnt; j++, p+=4) if(p[3]&3) nc++;
+            if(nc) {
+                nc = (U8)((((r>>1)&0x7FFFFFFF)*nc)>>31);
+                for(i=0, p=list+1; ; i++, p+=4) if((p[3]&3) && (nc--)==0) break;
+                }
+            }
+        p = list+1+(i<<2);
+        DoMove( p );
+        }
+    po_plies = ply;
+    while(undo_p>undo) UnDoMove();
+    return res;
+}
+
+void playoutsRun( long long n, int maxply, U8 policy, PlayoutStats *s ) {
+
+    long long i;
+    int r;
+
+    memset( s, 0, sizeof(PlayoutStats) );
+    mg_noflags = 1;
+    for(i=0; i<n; i++) {
+        r = Playout( maxply, policy );
+        if(r==1) s->win++;
+        else if(r==0) s->draw++;
+        else if(r<0) s->loss++;
+        else s->unfinished++;
+        s->plies += po_plies;
+        }
+    mg_noflags = 0;
+}
+
+/*
+    n playouts of current position, summed into s.
+    Forks workers (0-count of cpus), each on own copy of the board
+    and own random sequence of seed. Returns count of playouts.
+*/
+long long PlayoutsRun( long long n, int maxply, U8 policy, int workers, U64 seed, PlayoutStats *s ) {
+
+    PlayoutStats w;
+    long long part;
+    int i;
+#ifndef _WIN32
+    int fd[PO_WORKERS][2], st;
+    pid_t pid[PO_WORKERS];
+
+    if(workers<=0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(workers>PO_WORKERS) workers = PO_WORKERS;
+    if(n<workers) workers = (int)n;
+#else
+    workers = 1;
+#endif
+    if(workers<1) workers = 1;
+
+    memset( s, 0, sizeof(PlayoutStats) );
+    for(i=0; i<workers; i++) {
+        part = n/workers + (i < n%workers ? 1 : 0);
+        po_rnd = (seed ? seed : 1) ^ ((U64)(i+1)*0x9E3779B97F4A7C15LL);
+#ifndef _WIN32
+        pid[i] = -1;
+        if(workers>1 && pipe( fd[i] )==0) {
+            fflush(NULL);
+            pid[i] = fork();
+            if(pid[i]==0) {
+                close( fd[i][0] );
+                playoutsRun( part, maxply, policy, &w );
+                if(write( fd[i][1], &w, sizeof(w) )!=sizeof(w)) _exit(1);
+                _exit(0);
+                }
+            close( fd[i][1] );
+            if(pid[i]>0) continue;
+            close( fd[i][0] );
+            }
+#endif
+        playoutsRun( part, maxply, policy, &w );     // here, if could not fork
+        s->win += w.win; s->draw += w.draw; s->loss += w.loss;
+        s->unfinished += w.unfinished; s->plies += w.plies;
+        }
+#ifndef _WIN32
+    for(i=0; i<workers; i++) {
+        if(pid[i]<=0) continue;
+        memset( &w, 0, sizeof(w) );
+        if(read( fd[i][0], &w, sizeof(w) )==sizeof(w)) {
+            s->win += w.win; s->draw += w.draw; s->loss += w.loss;
+            s->unfinished += w.unfinished; s->plies += w.plies;
+            }
+        close( fd[i][0] );
+        waitpid( pid[i], &st, 0 );
+        }
+#endif
+    return s->win + s->draw + s->loss + s->unfinished;
+}
+
+//------------------------------------------
+//
+//	Move ordering
+//
+
+#define ORD_PLIES 128
+#define ORD_BEST (1<<30)            // best move of previous search, hash move
+#define ORD_GOOD (1<<28)            // captures and promotions not losing by SEE
+#define ORD_KILLER (1<<27)
+#define ORD_COUNTER ((1<<27)-2)
+#define ORD_HISTORY_MAX (1<<20)     // then halved, quiet moves stay under counter-move
+#define ORD_BAD (-(1<<28))          // losing captures, after quiet moves
+
+typedef struct {
+    U8 *mv;                 // moves, reordered while picking
+    int score[256];
+    U8 cnt, next;
+} MovePicker;
+
+U8 ord_killer[ORD_PLIES][2][2];     // from,to of quiet cut-off moves by ply
+U8 ord_counter[16][64][2];          // quiet reply by piece, to-square of previous move
+int ord_history[2][64][64];         // side, from, to
+
+// attacker rank for MVV-LVA: P,N,B,R,Q,K by PIECES[] order
+CONST U8 ord_lva[] = { 4, 3, 2, 1, 0, 5, 0, 0 };
+
+void OrderClear() {
+    memset( ord_killer, 0, sizeof(ord_killer) );
+    memset( ord_counter, 0, sizeof(ord_counter) );
+    memset( ord_history, 0, sizeof(ord_history) );
+}
+
+int orderScore( U8 *m, int ply, U8 *best, U8 *prev ) {
+
+    U8 ty = m[0]&15, fl = m[3], *k;
+    int s, v;
+
+    if(best!=NULL && best[1]==m[1] && best[2]==m[2] && ((best[3]^fl)&14)==0) return ORD_BEST;
+    if(fl&3) {
+        v = ((fl&1) ? SeeValues[(m[0]>>4)&7] : 0);
+        s = (v<<3) + ((fl&2) ? SeeValues[(fl>>2)&3] : 0) - ord_lva[ty&7];
+        if((fl&2)==0 && (v>=SeeValues[ty&7] || (ty&7)==5)) return ORD_GOOD + s;   // can not lose
+        v = SEE(m);
+        return (v>=0 ? ORD_GOOD + s : ORD_BAD + v);
+        }
+    if(ply>=0 && ply<ORD_PLIES) {
+        k = ord_killer[ply][0];
+        if(k[0]==m[1] && k[1]==m[2]) return ORD_KILLER+1;
+        if(k[2]==m[1] && k[3]==m[2]) return ORD_KILLER;
+        }
+    if(prev!=NULL) {
+        k = ord_counter[prev[0]&15][prev[2]];
+        if(k[0]==m[1] && k[1]==m[2] && (k[0]|k[1])) return ORD_COUNTER;
+        }
+    return ord_history[(ty>>3)&1][m[1]][m[2]];
+}
+
+/*
+    Scores cnt moves of mv (4 bytes each, as after MoveGen count byte).
+    ply for killers, best move first and prev (opponent's last move,
+    piece and to-square are used) may be NULL.
+*/
+void PickerInit( MovePicker *mp, U8 *mv, U8 cnt, int ply, U8 *best, U8 *prev ) {
+
+    U8 i;
+    mp->mv = mv;
+    mp->cnt = cnt;
+    mp->next = 0;
+    for(i=0; i<cnt; i++) mp->score[i] = orderScore( mv+(i<<2), ply, best, prev );
+}
+
+/*
+    Next move by score, swapped into its place in list, or NULL at end.
+*/
+U8 *PickNext( MovePicker *mp ) {
+
+    U8 i, b, t[4], *p, *q;
+    int s;
+
+    if(mp->next>=mp->cnt) return NULL;
+    for(b=i=mp->next; i<mp->cnt; i++) if(mp->score[i]>mp->score[b]) b = i;
+    p = mp->mv+(mp->next<<2);
+    if(b!=mp->next) {
+        q = mp->mv+(b<<2);
+        memcpy( t, p, 4 ); memcpy( p, q, 4 ); memcpy( q, t, 4 );
+        s = mp->score[b]; mp->score[b] = mp->score[mp->next]; mp->score[mp->next] = s;
+        }
+    mp->next++;
+    return p;
+}
+
+/*
+    Quiet move mv caused a beta cut-off at ply, depth left.
+    Captures and promotions are ordered by material and are not kept.
+*/
+void OrderCutoff( U8 *mv, int ply, int depth, U8 *prev ) {
+
+    int *h, i, j, k;
+    U8 *kl;
+
+    if(mv[3]&3) return;
+    if(ply>=0 && ply<ORD_PLIES) {
+        kl = ord_killer[ply][0];
+        if(kl[0]!=mv[1] || kl[1]!=mv[2]) {
+            kl[2] = kl[0]; kl[3] = kl[1];
+            kl[0] = mv[1]; kl[1] = mv[2];
+            }
+        }
+    if(prev!=NULL) {
+        kl = ord_counter[prev[0]&15][prev[2]];
+        kl[0] = mv[1]; kl[1] = mv[2];
+        }
+    h = &ord_history[(mv[0]>>3)&1][mv[1]][mv[2]];
+    *h += (depth>0 ? depth*depth : 1);
+    if(*h>=ORD_HISTORY_MAX) {
+        for(i=0; i<2; i++) for(j=0; j<64; j++) for(k=0; k<64; k++) ord_history[i][j][k] >>= 1;
+        }
+}
+
+//------------------------------------------
+//
+//	Tree walk
+//
+
+#define WALK_ALL 0
+#define WALK_CAPTURES 1             // captures and promotions only
+#define WALK_CHECKS 2               // check+ moves only, both bits: either
+#define WALK_INTERIOR 4             // visit nodes before their moves too
+
+typedef struct {
+    long long nodes;                // positions walked
+    long long leaves;               // at depth, or no moves to walk
+    long long visits;               // passed predicate (callback calls)
+} WalkStats;
+
+// path: moves from root, 4 bytes each, ply of them.
+// Returns 0-stop walk, 1-go on, 2-skip moves of this node.
+typedef int (*WalkVisit)( void *arg, int ply, U8 *path, U8 leaf );
+
+U8 *walk_arena, *walk_path;         // move lists by ply, moves made
+int walk_depth, walk_material;
+U8 walk_mode, walk_stop;
+WalkVisit walk_visit;
+void *walk_arg;
+WalkStats walk_st;
+
+U8 walkMove( U8 *p ) {
+    U8 f = walk_mode&3;
+    if(f==WALK_ALL) return 1;
+    return ( ((f&WALK_CAPTURES) && (p[3]&3)) || ((f&WALK_CHECKS) && (p[3]&64)) );
+}
+
+// |white-black| material at least walk_material centipawns
+U8 walkReport() {
+
+    U8 j;
+    int b = 0;
+    U64 o;
+
+    if(walk_material<=0) return 1;
+    for(j=0; j<5; j++) {
+        for(o=*PIECES[j]; o; o&=o-1) b += SeeValues[j];
+        for(o=*PIECES[j+8]; o; o&=o-1) b -= SeeValues[j];
+        }
+    return (b>=walk_material || -b>=walk_material);
+}
+
+void walkNode( int ply ) {
+
+    U8 *list = walk_arena+ply*(4<<8), *p, i, cnt = 0, n = 0, leaf;
+    int r = 1;
+    U64 *undo = undo_p;
+
+    walk_st.nodes++;
+    if(ply<walk_depth) {
+        mg_noflags = ((walk_mode&WALK_CHECKS) ? 0 : 1);
+        MoveGen( list );
+        mg_noflags = 0;
+        cnt = list[0];
+        for(i=0, p=list+1; i<cnt; i++, p+=4) if(walkMove( p )) n++;
+        }
+    leaf = (n==0);
+    if(leaf) walk_st.leaves++;
+    if((leaf || (walk_mode&WALK_INTERIOR)) && walkReport()) {
+        walk_st.visits++;
+        if(walk_visit!=NULL) r = walk_visit( walk_arg, ply, walk_path, leaf );
+        if(undo_p!=undo) { walk_stop = 2; return; }     // visit moved the board
+        if(r==0) { walk_stop = 1; return; }
+        }
+    if(leaf || r==2) return;
+
+    for(i=0, p=list+1; i<cnt && !walk_stop; i++, p+=4) {
+        if(!walkMove( p )) continue;
+        memcpy( walk_path+(ply<<2), p, 4 );
+        DoMove( p );
+        walkNode( ply+1 );
+        if(walk_stop==2) return;
+        UnDoMove();
+        }
+}
+
+/*
+    Walks tree of current position depth plies deep, up to room in undo
+    buffer. mode: WALK_ moves and nodes, material: 0 or predicate of
+    nodes to visit, visit may be NULL to count only. Board is restored.
+    Returns count of nodes, -1 if no memory, -2 if visit left the board
+    at other undo level (board not restored then).
+*/
+long long Walk( int depth, U8 mode, int material, WalkVisit visit, void *arg, WalkStats *s ) {
+
+    U64 *undo = undo_p;
+    int room = (int)((undobuffer+UNDO_REC*UNDO_PLIES-undo_p)/UNDO_REC) - 1;
+
+    if(depth>room) depth = room;
+    if(depth<0) depth = 0;
+    walk_arena = (U8 *)malloc( (depth+1)*(4<<8) );
+    walk_path = (U8 *)malloc( (depth+1)<<2 );
+    if(walk_arena==NULL || walk_path==NULL) {
+        free( walk_arena ); free( walk_path );
+        return -1;
+        }
+    walk_depth = depth;
+    walk_mode = mode;
+    walk_material = material;
+    walk_visit = visit;
+    walk_arg = arg;
+    walk_stop = 0;
+    memset( &walk_st, 0, sizeof(WalkStats) );
+
+    walkNode( 0 );
+
+    free( walk_arena ); free( walk_path );
+    memcpy( s, &walk_st, sizeof(WalkStats) );
+    return (walk_stop==2 ? -2 : s->nodes);
+}
+
+#endif  /* _INC_u64_SEARCH */